@@ -3,6 +3,7 @@
 #include "nhtl-extoll/notification_poller.h"
 #include "rma2.h"
 #include <cstdint>
+#include <span>
 #include <vector>
 
 namespace nhtl_extoll {
@@ -20,8 +21,9 @@ namespace nhtl_extoll {
  *  and would interpret them as virtual addresses instead of physical
  *  addresses, causing a translation of addresses which will fail.
  *  The size of the response buffer is one page size, which has to be 4096B
- *  for the card. However, only 64 bit, i.e., one Quad Word, are used.
- *  The send buffer makes up the  remaining 1023 pages.
+ *  for the card. It is split into 512 response slots of one Quad Word each, so that
+ *  many reads can be outstanding at the same time.
+ *  The send buffer makes up the remaining pages, by default 1023.
  */
 class PhysicalBuffer
 {
@@ -32,16 +34,25 @@ private:
 	constexpr static size_t quad_word_size_bt = sizeof(uint64_t);
 	/// Page size as required by the Tourmalet-ASIC in quad-words
 	constexpr static size_t page_size_qw = page_size_bt / quad_word_size_bt;
-	/// Combined size of the RRA response buffer and the RMA send buffer in pages
+	/// Maximum combined size of the RRA response buffer and the RMA send buffer in pages
 	/// Requesting more than 1024 pages causes fatal mmap() errors that can cause
 	/// the host to become unresponsive.
-	constexpr static size_t pages = 1024;
-	std::array<uint64_t, pages * page_size_qw>* m_buffer;
+	constexpr static size_t max_pages = 1024;
+	/// Combined size of the RRA response buffer and the RMA send buffer in pages
+	size_t m_pages;
+	uint64_t* m_buffer;
 	/// Use uint64_t instead of uintptr_t as Extoll uses uint64_t(=RMA2_NLA)
 	uint64_t m_physical_address;
 
 public:
-	explicit PhysicalBuffer() SYMBOL_VISIBLE;
+	/// Default size of the RMA send buffer in pages
+	constexpr static size_t default_send_pages = max_pages - 1;
+	/// Number of quad word slots in the RRA response buffer
+	constexpr static size_t response_slots = page_size_qw;
+
+	/// Maps a physical buffer with a send buffer of the given size in pages
+	/// @throws std::invalid_argument if the send buffer exceeds 1023 pages
+	explicit PhysicalBuffer(size_t send_pages = default_send_pages) SYMBOL_VISIBLE;
 	/// This class is moveable as the underlying registered memory
 	/// region is stable address-wise
 	PhysicalBuffer(PhysicalBuffer&&) = default;
@@ -51,16 +62,19 @@ public:
 	PhysicalBuffer& operator=(PhysicalBuffer const&) = delete;
 	~PhysicalBuffer() SYMBOL_VISIBLE;
 
-	/// Returns the Network Logical Address (NLA) of the buffer.
+	/// Returns the Network Logical Address (NLA) of the given response slot, by default
+	/// of the start of the buffer.
 	/// Note that this uses physical addresses.
-	RMA2_NLA response_address() const SYMBOL_VISIBLE;
+	/// @throws std::out_of_range if the slot does not exist
+	RMA2_NLA response_address(size_t slot = 0) const SYMBOL_VISIBLE;
 	/// Returns the Network Logical Address (NLA) of the send buffer
 	/// This is offset by 1 page from the start of the PhysicalBuffer
 	RMA2_NLA send_address() const SYMBOL_VISIBLE;
 	/// Returns the size of the send buffer in quad words
 	size_t send_buffer_size_qw() const SYMBOL_VISIBLE;
-	/// Return the quad word written at the start of the RRA response buffer
-	uint64_t read_response() const SYMBOL_VISIBLE;
+	/// Return the quad word written to the given slot of the RRA response buffer
+	/// @throws std::out_of_range if the slot does not exist
+	uint64_t read_response(size_t slot = 0) const SYMBOL_VISIBLE;
 	/// Return the quad word at the given index of the send buffer
 	/// This is offset by 1 page from the start of the PhysicalBuffer
 	uint64_t read_send(size_t index) const SYMBOL_VISIBLE;
@@ -96,10 +110,67 @@ public:
 	/// Identifier for the trace ring buffer
 	constexpr static uint64_t trace_identifier = 0x0ca5;
 
-	/// Creates a ringbuffer from an RMA network port and handle,
-	/// an associated NotificationPoller, and the buffer size in pages
-	RingBuffer(RMA2_Port port, RMA2_Handle handle, NotificationPoller& p, size_t pages)
-	    SYMBOL_VISIBLE;
+	/// Layout of the ring buffer memory in the virtual address space of the process
+	enum class Layout
+	{
+		/// A single mapping, readable words may wrap around the end of the buffer
+		linear,
+		/// The same memory mapped twice back to back, only the first mapping is
+		/// registered with the driver. Readable words are always contiguous in
+		/// virtual memory, even across the wrap-around point.
+		mirrored
+	};
+
+	/// Size of a huge page used to back the buffer in byte
+	constexpr static size_t huge_page_size_bt = 2 * 1024 * 1024;
+
+	/// Allocation mode of the ring buffer memory
+	enum class Allocation
+	{
+		/// Regular pages, faulted in on first access
+		standard,
+		/// Regular pages, locked into memory and pre-faulted on allocation
+		locked,
+		/// Locked and pre-faulted 2 MiB huge pages. Falls back to locked regular pages
+		/// if the buffer size is no multiple of the huge page size, no huge pages are
+		/// available or the driver refuses to register them.
+		huge_pages
+	};
+
+	/**
+	 *  Zero-copy view onto the readable quad words of the ring buffer.
+	 *  The words are split into at most two contiguous segments, the second one
+	 *  only being non-empty if the readable words wrap around the end of the buffer.
+	 *  A view stays valid until the words are released or the buffer is reset.
+	 */
+	struct View
+	{
+		/// Words starting at the read index up to the end of the buffer
+		std::span<uint64_t const> first;
+		/// Words wrapped around to the start of the buffer
+		std::span<uint64_t const> second;
+
+		/// Total number of quad words in the view
+		size_t size() const
+		{
+			return first.size() + second.size();
+		}
+		/// Whether the view contains no quad words at all
+		bool empty() const
+		{
+			return first.empty() && second.empty();
+		}
+	};
+
+	/// Creates a ringbuffer from an RMA network port and handle, an associated
+	/// NotificationPoller, the buffer size in pages, the memory layout and allocation mode
+	RingBuffer(
+	    RMA2_Port port,
+	    RMA2_Handle handle,
+	    NotificationPoller& p,
+	    size_t pages,
+	    Layout layout = Layout::linear,
+	    Allocation allocation = Allocation::standard) SYMBOL_VISIBLE;
 	/// Frees all resources and does a last sync with the remote Fpga
 	~RingBuffer() SYMBOL_VISIBLE;
 	/// This class is moveable as the underlying registered memory
@@ -112,12 +183,89 @@ public:
 
 	/// Blocks and reads all quad words from the buffer
 	std::vector<uint64_t> receive() SYMBOL_VISIBLE;
+	/// Blocks and reads as many quad words as fit into the given caller-owned memory.
+	/// Words that do not fit stay readable for the next call.
+	/// Returns the number of quad words written.
+	size_t receive_into(std::span<uint64_t> destination) SYMBOL_VISIBLE;
+	/// Blocks and appends all readable quad words to the given vector, reusing its capacity.
+	/// Returns the number of quad words appended.
+	size_t receive_append(std::vector<uint64_t>& destination) SYMBOL_VISIBLE;
+	/**
+	 *  Blocks until at least `min_words` quad words are readable or the deadline passes
+	 *  and reads at most `max_words` of them. Remaining words stay readable for the next
+	 *  call. Fewer than `min_words` are returned only if the deadline passed, a minimum
+	 *  larger than the buffer is capped to the buffer size.
+	 *  @code
+	 *  // Large batches for throughput, but never wait longer than 5 ms
+	 *  auto words = ring.receive(16384, 65536, std::chrono::steady_clock::now() + 5ms);
+	 *  @endcode
+	 *  @throws std::invalid_argument if `min_words` exceeds `max_words`
+	 */
+	std::vector<uint64_t> receive(
+	    size_t min_words,
+	    size_t max_words,
+	    std::chrono::steady_clock::time_point deadline) SYMBOL_VISIBLE;
+	/// Like `receive(min_words, max_words, deadline)` with the size of the given caller-owned
+	/// memory as maximum. Returns the number of quad words written.
+	/// @throws std::invalid_argument if `min_words` exceeds the destination size
+	size_t receive_into(
+	    std::span<uint64_t> destination,
+	    size_t min_words,
+	    std::chrono::steady_clock::time_point deadline) SYMBOL_VISIBLE;
+	/// Reads all quad words already announced without waiting, e.g. after the poller's
+	/// event file descriptor became readable
+	std::vector<uint64_t> try_receive() SYMBOL_VISIBLE;
+	/// Awaitable completing once at least the requested number of words is readable
+	class BatchAwaiter : public NotificationAwaiter
+	{
+	public:
+		BatchAwaiter(
+		    RingBuffer& ring,
+		    size_t min_words,
+		    std::chrono::steady_clock::time_point deadline) SYMBOL_VISIBLE;
+		/// Reads all readable quad words, fewer than requested if the deadline passed
+		/// @throws any error that occurred while dispatching notifications
+		std::vector<uint64_t> await_resume() SYMBOL_VISIBLE;
+
+	private:
+		RingBuffer& m_ring;
+		size_t m_min_words;
+
+		bool try_complete() override;
+	};
+	/**
+	 *  Suspends the awaiting coroutine until at least `min_words` quad words are readable
+	 *  or the deadline passes, without blocking a thread.
+	 *  The coroutine is resumed on the poller thread, see NotificationAwaiter.
+	 *  @code
+	 *  auto words = co_await ring.next_batch(4096, std::chrono::steady_clock::now() + 1ms);
+	 *  @endcode
+	 */
+	BatchAwaiter next_batch(size_t min_words, std::chrono::steady_clock::time_point deadline)
+	    SYMBOL_VISIBLE;
+	/// Blocks and returns a view onto all readable quad words without copying them.
+	/// For a mirrored layout, the second segment of the view is always empty.
+	/// The words are not consumed and no credits are returned to the Fpga until they
+	/// are released.
+	View receive_view() SYMBOL_VISIBLE;
+	/// Consumes the given number of quad words from the front of the readable words
+	/// and returns the credits to the Fpga
+	/// @throws std::out_of_range if more words are released than are readable
+	void release(size_t words) SYMBOL_VISIBLE;
+	/// Consumes all quad words of a view obtained by `receive_view()`
+	void release(View const& view) SYMBOL_VISIBLE;
 	/// Does a hard reset without notifying the hardware
 	void reset() SYMBOL_VISIBLE;
 	/// Accessor for the memory region
 	RMA2_Region* region() const SYMBOL_VISIBLE;
 	/// The NLA of the mapped memory region with an optional offset in bytes
 	RMA2_NLA address(size_t offset) const SYMBOL_VISIBLE;
+	/// The memory layout of the buffer
+	Layout layout() const SYMBOL_VISIBLE;
+	/// The requested allocation mode of the buffer
+	Allocation allocation() const SYMBOL_VISIBLE;
+	/// Whether the buffer is actually backed by huge pages
+	bool huge_pages() const SYMBOL_VISIBLE;
 
 private:
 	/// The network port
@@ -126,6 +274,14 @@ private:
 	RMA2_Handle m_handle = nullptr;
 	/// Notification poller listening for ring buffer notifications
 	NotificationPoller& m_poller;
+	/// The memory layout of the buffer
+	Layout m_layout;
+	/// The requested allocation mode of the buffer
+	Allocation m_allocation;
+	/// Whether the buffer is backed by huge pages
+	bool m_huge_pages = false;
+	/// The memory file backing both mappings of a mirrored buffer
+	int m_memory_fd = -1;
 	/// The address of the buffer
 	void* m_address;
 	/// The user-space buffer
@@ -139,8 +295,19 @@ private:
 	/// Number of words read without notifying the FPGA
 	size_t m_read_words = 0;
 
-	/// Checks with the poller if new words have arrived
-	bool poll();
+	/// Checks with the poller if new words have arrived, waiting up to the timeout
+	bool poll(std::chrono::nanoseconds timeout);
+	/// Polls until at least the given number of words is readable or the deadline passes.
+	/// Returns false if the deadline passed.
+	bool poll_until(size_t min_words, std::chrono::steady_clock::time_point deadline);
+	/// View onto all readable quad words known so far
+	View readable_view() const;
+
+	/// Allocates the buffer memory according to the layout and allocation mode.
+	/// Returns false if huge pages were requested but are not available.
+	bool allocate(bool huge_pages);
+	/// Frees the buffer memory according to the layout and allocation mode
+	void deallocate();
 
 	uint64_t const& operator[](size_t position) const;
 	uint64_t& operator[](size_t position);
@@ -0,0 +1,79 @@
+#pragma once
+#include "hate/visibility.h"
+#include "nhtl-extoll/notification_counter.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+namespace nhtl_extoll {
+
+/**
+ *  Matches the completion notifications of register accesses to the accesses by posting
+ *  order. Every access gets a ticket when it is posted, and the access with ticket `t`
+ *  has completed once more than `t` completions were counted, so many threads can wait
+ *  for their own accesses.
+ *
+ *  A completion that never arrives, e.g. because the Fpga was reset or the link dropped
+ *  while an access was outstanding, would leave every later access one completion behind.
+ *  An access still incomplete `lost_after` after it was posted is therefore treated as
+ *  lost when it is abandoned after waiting for it timed out: the count is raised to
+ *  include it and all earlier accesses. A completion arriving even later is mistaken for
+ *  that of the next access.
+ */
+class CompletionTickets
+{
+public:
+	/// Number of most recent accesses whose post and completion times are kept
+	constexpr static size_t history = 1024;
+
+	explicit CompletionTickets(std::chrono::nanoseconds lost_after) SYMBOL_VISIBLE;
+	/// This class is not copyable
+	CompletionTickets(CompletionTickets const&) = delete;
+	/// This class is not copy-assignable
+	CompletionTickets& operator=(CompletionTickets const&) = delete;
+
+	/// Serializes posting, as tickets have to follow the order accesses are posted in
+	std::unique_lock<std::mutex> lock_posting() SYMBOL_VISIBLE;
+	/// Issues the tickets of `count` accesses posted while holding the lock and returns
+	/// the first one
+	uint64_t issue(std::unique_lock<std::mutex> const& lock, size_t count = 1) SYMBOL_VISIBLE;
+
+	/// Counts the completion of the oldest incomplete access. With `stamp`, the current
+	/// time is kept for `completed_at()`.
+	void complete(bool stamp = false) SYMBOL_VISIBLE;
+
+	/// Number of completions counted, including lost ones
+	uint64_t completions() const SYMBOL_VISIBLE;
+	/// Whether the access with the ticket has completed or was lost
+	bool completed(uint64_t ticket) const SYMBOL_VISIBLE;
+	/// Waits up to the timeout for the access with the ticket to complete.
+	/// Returns false if the timeout expired.
+	bool wait_for(uint64_t ticket, std::chrono::nanoseconds timeout) SYMBOL_VISIBLE;
+	/// Gives up waiting for an incomplete access. If it is overdue, it and all earlier
+	/// accesses are counted as complete, so that later tickets match their completions.
+	void abandon(uint64_t ticket) SYMBOL_VISIBLE;
+	/// Time the completion of the access was counted, if it was stamped and is still in
+	/// the history
+	std::optional<std::chrono::steady_clock::time_point> completed_at(uint64_t ticket) const
+	    SYMBOL_VISIBLE;
+
+	/// The counter of completions, e.g. for ResponseSlots
+	NotificationCounter const& counter() const SYMBOL_VISIBLE;
+
+private:
+	std::chrono::nanoseconds const m_lost_after;
+	NotificationCounter m_completions;
+	std::mutex m_post_mutex;
+	/// Number of accesses posted, i.e. the ticket of the next one
+	uint64_t m_posted = 0;
+	/// Post time per ticket modulo `history` in steady clock nanoseconds
+	std::array<std::atomic<int64_t>, history> m_posted_at{};
+	/// Completion time per ticket modulo `history` in steady clock nanoseconds, zero if
+	/// it was not stamped
+	std::array<std::atomic<int64_t>, history> m_completed_at{};
+};
+
+} // namespace nhtl_extoll
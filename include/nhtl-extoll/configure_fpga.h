@@ -55,6 +55,9 @@ struct PartnerHostConfiguration
 	Ringbuffer trace;
 
 	uint32_t hicann_trace_pkt_closure;
+
+	/// Whether the Hicann ringbuffer is configured and initialized at all
+	bool hicann_enabled = true;
 };
 
 void SYMBOL_VISIBLE configure_fpga(Endpoint& connection, PartnerHostConfiguration config);
@@ -1,8 +1,16 @@
 #pragma once
 #include "hate/visibility.h"
 #include "nhtl-extoll/buffer.h"
+#include "nhtl-extoll/completion_tickets.h"
 #include "nhtl-extoll/notification_poller.h"
+#include "nhtl-extoll/poller_group.h"
+#include "nhtl-extoll/register_snapshot.h"
+#include "nhtl-extoll/response_slots.h"
 #include "rma2.h"
+#include <chrono>
+#include <optional>
+#include <span>
+#include <vector>
 
 namespace nhtl_extoll {
 
@@ -42,9 +50,40 @@ public:
 	~Connection() SYMBOL_VISIBLE;
 };
 
+/// Sizing and allocation options of the host-side buffers of an Endpoint
+struct EndpointOptions
+{
+	/// Whether the HICANN ring buffer is allocated and configured at all
+	bool hicann_ring = true;
+	/// Size of the HICANN ring buffer in pages
+	size_t hicann_ring_pages = 1;
+	/// Size of the trace ring buffer in pages
+	size_t trace_ring_pages = 2048;
+	/// Memory layout of the trace ring buffer
+	RingBuffer::Layout trace_ring_layout = RingBuffer::Layout::linear;
+	/// Allocation mode of the trace ring buffer
+	RingBuffer::Allocation trace_ring_allocation = RingBuffer::Allocation::standard;
+	/// Size of the RMA send buffer in pages, at most 1023
+	size_t send_buffer_pages = PhysicalBuffer::default_send_pages;
+	/// How the notification poller thread waits for notifications
+	PollingPolicy polling_policy;
+	/// Where the notification poller thread runs
+	PollerPlacement poller_placement;
+	/// How the poller of the RRA port waits for register responses. By default it blocks
+	/// in the driver like the former synchronous register accesses did.
+	PollingPolicy rra_polling_policy = PollingPolicy::blocking();
+	/// Group polling the notifications instead of a thread per Endpoint, overrides
+	/// `polling_policy`, `rra_polling_policy` and `poller_placement`.
+	/// Must outlive the Endpoint.
+	PollerGroup* poller_group = nullptr;
+};
+
 /**
  *  Encapsulates the various handles needed for the `librma2` to represent a connection.
  *  Extoll keeps track of all Connections internally.
+ *
+ *  Register file accesses are thread-safe. Every read gets a response slot of its own,
+ *  and completions are matched to the waiting caller by posting order.
  */
 struct Endpoint
 {
@@ -55,6 +94,34 @@ private:
 	Connection m_rra;
 	/// A remote memory access connection
 	Connection m_rma;
+	/// The options the buffers were created with
+	EndpointOptions m_options;
+
+	/// Matches register responses to the accesses, which complete in posting order
+	mutable CompletionTickets m_rra_tickets;
+	/// Response slots not used by an outstanding read
+	mutable ResponseSlots m_response_slots;
+
+	/// Takes up to `slots.size()` response slots for reads starting at the address
+	/// @throws FailedToRead if no slot becomes free within `rra_timeout`
+	size_t acquire_slots(std::span<size_t> slots, RMA2_NLA address) const;
+	/// Posts a read of the address into the response slot and returns its ticket
+	/// @throws FailedToRead if the read cannot be posted
+	uint64_t post_read(RMA2_NLA address, size_t slot) const;
+	/// Posts a write and returns its ticket
+	/// @throws FailedToWrite if the write cannot be posted
+	uint64_t post_write(RMA2_NLA address, uint64_t value);
+	/// Whether the access with the ticket has completed
+	bool completed(uint64_t ticket) const;
+	/// Waits up to the timeout for the access with the ticket to complete and records its
+	/// response latency, see CompletionTickets for accesses whose response is lost
+	/// @throws any error that occurred while dispatching RRA notifications
+	bool wait_for(uint64_t ticket, std::chrono::nanoseconds timeout) const;
+	/// Reads a register through a slot of its own
+	/// @throws FailedToRead if the read cannot be posted or times out
+	uint64_t read_register(RMA2_NLA address, std::chrono::nanoseconds timeout) const;
+
+	friend class RraBatch;
 
 public:
 	/**
@@ -62,10 +129,17 @@ public:
 	 * and should be adjusted if the register file is changed.
 	 */
 	constexpr static uint64_t max_address = 0x180d0;
+	/// The whole register file address space
+	constexpr static RegisterRange all_registers{0, max_address};
 
 	constexpr static RMA2_NLA hicann_address = 0x2a1bull << 48;
 	constexpr static RMA2_NLA trace_address = 0x0ca5ull << 48;
 
+	/// Time to wait for the response to a register file access
+	constexpr static std::chrono::milliseconds rra_timeout{1000};
+	/// Time to wait for the Fpga to answer a ping
+	constexpr static std::chrono::milliseconds ping_timeout{10000};
+
 	RMA2_Nodeid get_node() const SYMBOL_VISIBLE;
 
 	RMA2_Port get_rra_port() const SYMBOL_VISIBLE;
@@ -76,21 +150,35 @@ public:
 	RMA2_Handle get_rma_handle() const SYMBOL_VISIBLE;
 	RMA2_VPID get_rma_vpid() const SYMBOL_VISIBLE;
 
-	NotificationPoller poller;
+	EndpointOptions const& options() const SYMBOL_VISIBLE;
 
 	/// A buffer that acts as a response buffer for RRA traffic and send buffer
 	/// for RMA traffic.
+	/// Declared before the pollers, as coroutines still resumed while they stop may read it.
 	PhysicalBuffer buffer;
+
+	/// Poller of the RMA port, dispatching ring buffer notifications
+	NotificationPoller poller;
+	/// Poller of the RRA port, dispatching register responses.
+	/// Mutable as reading registers waits for its notifications.
+	/// The Endpoint counts the responses itself to match them to the accesses, so the
+	/// response consuming calls and `next_response()` of this poller throw, and
+	/// `event_fd()` does not reflect responses. Use the tokens of `rra_read_async()` and
+	/// `rra_write_async()` instead. `response_latency()` records the time from probing a
+	/// response to the waiting access returning.
+	mutable NotificationPoller rra_poller;
+
 	/// The HICANN ring buffer
-	/// Currently not used but required for successful configuration
-	RingBuffer hicann_ring_buffer;
+	/// Currently not used but required for successful configuration.
+	/// Empty if disabled in the EndpointOptions.
+	std::optional<RingBuffer> hicann_ring_buffer;
 	/// The trace data ring buffer
 	/// Currently used for all incoming RMA traffic
 	RingBuffer trace_ring_buffer;
 
-	/// Opens a connection to a remote node.
+	/// Opens a connection to a remote node and allocates the buffers as given by the options.
 	/// @throws ConnectionFailed if there is an error inside `librma2`
-	explicit Endpoint(RMA2_Nodeid) SYMBOL_VISIBLE;
+	explicit Endpoint(RMA2_Nodeid, EndpointOptions options = {}) SYMBOL_VISIBLE;
 	/// This class is moveable as the underlying registered memory
 	/// region is stable address-wise
 	Endpoint(Endpoint&&) = default;
@@ -100,7 +188,7 @@ public:
 	Endpoint& operator=(Endpoint const&) = delete;
 
 	/// Attempt to read the FPGA identifier at 0x8000 via RRA
-	/// Returns true if the FPGA answers within 1ms, false otherwise
+	/// Returns true if the FPGA answers within `ping_timeout`, false otherwise
 	bool ping() const SYMBOL_VISIBLE;
 
 	/**
@@ -154,6 +242,37 @@ public:
 	 */
 	uint64_t rra_read(RMA2_NLA) const SYMBOL_VISIBLE;
 
+	/**
+	 *  Reads many register files with about one round trip per
+	 *  `PhysicalBuffer::response_slots` addresses.
+	 *
+	 *  All reads are posted back to back to distinct slots of the response buffer before
+	 *  their responses are collected. Like the single read, this method is untyped.
+	 *  @code
+	 *  std::array<RMA2_NLA, 2> const addresses{TraceBufferStart::rf_address, 0x8000};
+	 *  auto values = endpoint.rra_read(addresses);
+	 *  @endcode
+	 *  @throws FailedToRead for the address of the first read that cannot be posted or
+	 *  does not complete within `rra_timeout`
+	 */
+	std::vector<uint64_t> rra_read(std::span<RMA2_NLA const> addresses) const SYMBOL_VISIBLE;
+
+	/**
+	 *  Reads every register of the range with the batched `rra_read()` and returns a
+	 *  sparse image of it, e.g. to capture the full Fpga state after a failed run.
+	 *  @code
+	 *  auto const before = endpoint.snapshot_registers();
+	 *  run_experiment();
+	 *  for (auto const& change : endpoint.snapshot_registers().diff(before)) {
+	 *  	std::cout << std::hex << change.address << ": " << change.after << "\n";
+	 *  }
+	 *  @endcode
+	 *  @throws std::invalid_argument if the range is not quad word aligned or exceeds
+	 *  `max_address`
+	 *  @throws FailedToRead for the address of the first read that failed
+	 */
+	RegisterSnapshot snapshot_registers(RegisterRange range = all_registers) const SYMBOL_VISIBLE;
+
 	/**
 	 *  A non-template version of the write method.
 	 *
@@ -162,6 +281,132 @@ public:
 	 */
 	void rra_write(RMA2_NLA, uint64_t) SYMBOL_VISIBLE;
 
+	/**
+	 *  Token of a register access in flight, returned by `rra_read_async()` and
+	 *  `rra_write_async()`. It can be polled with `ready()`, waited for with `wait()` or
+	 *  `get()`, or awaited by a coroutine, which is then resumed on the RRA poller thread,
+	 *  see NotificationAwaiter.
+	 */
+	class RraCompletion : public NotificationAwaiter
+	{
+	public:
+		/// Whether the access has completed, without waiting
+		bool ready() const SYMBOL_VISIBLE;
+		/// Blocks until the access completed or its deadline passed.
+		/// Returns false if the deadline passed.
+		/// @throws any error that occurred while dispatching RRA notifications
+		bool wait() const SYMBOL_VISIBLE;
+		/// The accessed register file address
+		RMA2_NLA address() const SYMBOL_VISIBLE;
+
+	protected:
+		RraCompletion(
+		    Endpoint const& endpoint,
+		    RMA2_NLA address,
+		    uint64_t ticket,
+		    std::chrono::steady_clock::time_point deadline) SYMBOL_VISIBLE;
+
+		Endpoint const& m_endpoint;
+		RMA2_NLA m_address;
+		uint64_t m_ticket;
+
+	private:
+		bool try_complete() override;
+	};
+
+	/// Completion token of `rra_read_async()`, owning the response slot of the read
+	class ReadCompletion : public RraCompletion
+	{
+	public:
+		ReadCompletion(
+		    Endpoint const& endpoint,
+		    RMA2_NLA address,
+		    uint64_t ticket,
+		    size_t slot,
+		    std::chrono::steady_clock::time_point deadline) SYMBOL_VISIBLE;
+		ReadCompletion(ReadCompletion&& other) SYMBOL_VISIBLE;
+		/// Returns the response slot, or defers that until the response arrived if the
+		/// read has not completed yet
+		~ReadCompletion() SYMBOL_VISIBLE;
+
+		/// Blocks until the read completed and returns the value read
+		/// @throws FailedToRead if no response arrived before the deadline
+		uint64_t get() SYMBOL_VISIBLE;
+		/// Returns the value read, cf. `get()`
+		uint64_t await_resume() SYMBOL_VISIBLE;
+
+	private:
+		std::optional<size_t> m_slot;
+		std::optional<uint64_t> m_value;
+	};
+
+	/// Completion token of `rra_write_async()`
+	class WriteCompletion : public RraCompletion
+	{
+	public:
+		WriteCompletion(
+		    Endpoint const& endpoint,
+		    RMA2_NLA address,
+		    uint64_t ticket,
+		    std::chrono::steady_clock::time_point deadline) SYMBOL_VISIBLE;
+
+		/// Blocks until the write completed
+		/// @throws FailedToWrite if no response arrived before the deadline
+		void get() SYMBOL_VISIBLE;
+		/// cf. `get()`
+		void await_resume() SYMBOL_VISIBLE;
+	};
+
+	/**
+	 *  Posts a register read and returns a token for its value, so that host-side work
+	 *  can overlap with the round trip.
+	 *
+	 *  Any number of accesses may be in flight, each read holds a response slot until
+	 *  its value is taken or its response arrived after the token was dropped.
+	 *  @code
+	 *  auto identifier = endpoint.rra_read_async(0x8000);
+	 *  prepare_payload(endpoint.buffer);
+	 *  if (identifier.get() != 0xcafebabe) { ... }
+	 *  // or within a coroutine
+	 *  uint64_t value = co_await endpoint.rra_read_async(0x8000);
+	 *  @endcode
+	 *  @throws FailedToRead if the read cannot be posted
+	 */
+	ReadCompletion rra_read_async(
+	    RMA2_NLA address,
+	    std::chrono::steady_clock::time_point deadline =
+	        std::chrono::steady_clock::now() + rra_timeout) const SYMBOL_VISIBLE;
+
+	/// Posts a register write and returns a token for its completion,
+	/// cf. `rra_read_async()`
+	/// @throws FailedToWrite if the write cannot be posted
+	WriteCompletion rra_write_async(
+	    RMA2_NLA address,
+	    uint64_t value,
+	    std::chrono::steady_clock::time_point deadline =
+	        std::chrono::steady_clock::now() + rra_timeout) SYMBOL_VISIBLE;
+
+	/**
+	 *  Blocks until every completion token of the range completed or its deadline passed.
+	 *  Tokens of different types can be combined by reference:
+	 *  @code
+	 *  std::array<std::reference_wrapper<Endpoint::RraCompletion const>, 2> const tokens{
+	 *      read, write};
+	 *  Endpoint::wait_all(tokens);
+	 *  @endcode
+	 *  Returns false if any deadline passed.
+	 *  @throws any error that occurred while dispatching RRA notifications
+	 */
+	template <typename Completions>
+	static bool wait_all(Completions const& completions)
+	{
+		bool all = true;
+		for (auto const& completion : completions) {
+			all = static_cast<RraCompletion const&>(completion).wait() && all;
+		}
+		return all;
+	}
+
 	/**
 	 * Send data via the RMA connection.
 	 */
@@ -60,6 +60,19 @@ struct FailedToWrite : RraError
 	FailedToWrite(RMA2_Nodeid node, RMA2_NLA address) SYMBOL_VISIBLE;
 };
 
+/// This exception indicates that a notification of a class without registered handler was
+/// received
+struct UnknownNotificationClass : RmaError
+{
+	/// Creates an exception from the class and the payload of the notification
+	UnknownNotificationClass(RMA2_Class cls, uint64_t payload) SYMBOL_VISIBLE;
+
+	/// The class of the notification
+	RMA2_Class const cls;
+	/// The full payload of the notification
+	uint64_t const payload;
+};
+
 /// This exception occurs when the user tries to connect to a remote node that is not an
 /// properly configured FPGA
 struct NodeIsNoFpga : ConnectionFailed
@@ -0,0 +1,69 @@
+#pragma once
+#include "hate/visibility.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace nhtl_extoll {
+
+/**
+ *  Histogram of latencies with logarithmically growing buckets, each split into
+ *  `sub_buckets` linear ones. Latencies below `2 * sub_buckets` ns are counted exactly,
+ *  larger ones with a relative error below `1 / sub_buckets`.
+ *  Recording is lock-free and may happen concurrently with reading, a reader sees each
+ *  bucket consistently but not necessarily all buckets at the same instant.
+ */
+class LatencyHistogram
+{
+public:
+	/// Number of linear buckets per power of two
+	constexpr static size_t sub_buckets = 16;
+	/// Total number of buckets covering all 64 bit nanosecond values
+	constexpr static size_t bucket_count = (64 - 4 + 1) * sub_buckets;
+
+	/// A non-empty bucket, covering latencies in [lower, upper]
+	struct Bucket
+	{
+		std::chrono::nanoseconds lower;
+		std::chrono::nanoseconds upper;
+		uint64_t count;
+	};
+
+	LatencyHistogram() = default;
+	/// This class is not copyable
+	LatencyHistogram(LatencyHistogram const&) = delete;
+	/// This class is not copy-assignable
+	LatencyHistogram& operator=(LatencyHistogram const&) = delete;
+
+	/// Counts a latency, negative ones as zero
+	void record(std::chrono::nanoseconds latency) SYMBOL_VISIBLE;
+
+	/// Number of recorded latencies
+	uint64_t count() const SYMBOL_VISIBLE;
+	/// Mean of all recorded latencies, zero if none was recorded
+	std::chrono::nanoseconds mean() const SYMBOL_VISIBLE;
+	/// Largest recorded latency
+	std::chrono::nanoseconds max() const SYMBOL_VISIBLE;
+	/// Upper bound of the bucket containing the given fraction of all latencies,
+	/// e.g. 0.99 for the 99th percentile. Zero if none was recorded.
+	std::chrono::nanoseconds percentile(double fraction) const SYMBOL_VISIBLE;
+	/// All non-empty buckets in ascending order
+	std::vector<Bucket> buckets() const SYMBOL_VISIBLE;
+
+	/// Clears all counts. Latencies recorded concurrently may be partially lost.
+	void reset() SYMBOL_VISIBLE;
+
+private:
+	std::array<std::atomic<uint64_t>, bucket_count> m_buckets{};
+	std::atomic<uint64_t> m_count{0};
+	std::atomic<uint64_t> m_sum_ns{0};
+	std::atomic<uint64_t> m_max_ns{0};
+
+	static size_t index(uint64_t latency_ns);
+	static uint64_t lower_bound(size_t index);
+	static uint64_t upper_bound(size_t index);
+};
+
+} // namespace nhtl_extoll
@@ -0,0 +1,55 @@
+#pragma once
+#include "hate/visibility.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace nhtl_extoll {
+
+/**
+ *  Counter incremented by the notification poller thread and consumed by other threads.
+ *  Updates are lock-free. Consumers finding the counter empty park on a futex, and the
+ *  producer only issues a wake-up system call while a consumer is actually parked.
+ */
+class NotificationCounter
+{
+public:
+	NotificationCounter() = default;
+	/// This class is not copyable
+	NotificationCounter(NotificationCounter const&) = delete;
+	/// This class is not copy-assignable
+	NotificationCounter& operator=(NotificationCounter const&) = delete;
+
+	/// Adds to the counter and wakes parked consumers
+	void add(uint64_t value) SYMBOL_VISIBLE;
+	/// Raises the counter to at least the target and wakes parked consumers
+	void raise_to(uint64_t target) SYMBOL_VISIBLE;
+
+	/// Takes the whole count, waiting up to the timeout for it to become non-zero.
+	/// Returns zero if the timeout expired.
+	uint64_t consume_all(std::chrono::nanoseconds timeout) SYMBOL_VISIBLE;
+	/// Takes a single count, waiting up to the timeout for it to become non-zero.
+	/// Returns false if the timeout expired.
+	bool consume_one(std::chrono::nanoseconds timeout) SYMBOL_VISIBLE;
+
+	/// Current count without consuming it
+	uint64_t value() const SYMBOL_VISIBLE;
+	/// Waits up to the timeout for the count to reach the target without consuming it,
+	/// for counters used as a monotonic sequence. Returns false if the timeout expired.
+	bool wait_until(uint64_t target, std::chrono::nanoseconds timeout) SYMBOL_VISIBLE;
+
+private:
+	std::atomic<uint64_t> m_value{0};
+	/// Futex word, changed by the producer before waking parked consumers
+	std::atomic<uint32_t> m_epoch{0};
+	/// Number of consumers about to park or parked
+	std::atomic<uint32_t> m_waiters{0};
+
+	/// Wakes parked consumers after the value changed
+	void wake();
+	/// Takes the whole count or a single one without waiting
+	uint64_t try_consume(bool all);
+	uint64_t consume(bool all, std::chrono::nanoseconds timeout);
+};
+
+} // namespace nhtl_extoll
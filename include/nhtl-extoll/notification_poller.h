@@ -1,38 +1,405 @@
 #pragma once
 #include "hate/visibility.h"
+#include "nhtl-extoll/latency_histogram.h"
+#include "nhtl-extoll/notification_counter.h"
+#include "nhtl-extoll/spsc_queue.h"
 #include "rma2.h"
+#include <array>
 #include <atomic>
 #include <chrono>
-#include <condition_variable>
+#include <coroutine>
+#include <ctime>
+#include <exception>
+#include <functional>
+#include <memory>
 #include <mutex>
-#include <sched.h>
+#include <optional>
 #include <thread>
+#include <utility>
+#include <vector>
 
 namespace nhtl_extoll {
 
+/// How the poller thread waits while no notification is pending
+struct PollingPolicy
+{
+	enum class Strategy
+	{
+		/// Probe continuously, only relaxing the core with a pause instruction.
+		/// Lowest latency, occupies a whole core.
+		busy_spin,
+		/// Spin for `spin_probes` empty probes, then yield for `yield_probes` empty probes,
+		/// then sleep for `hybrid_sleep` between probes
+		hybrid,
+		/// Sleep between probes, doubling the period from `min_sleep` up to `max_sleep`.
+		/// Cheapest, but the first notification after an idle phase may be seen late.
+		backoff,
+		/// Block in the driver with `rma2_noti_get_block` until a notification arrives.
+		/// Near-zero idle CPU load and interrupt-driven wake-ups. After a failed wait the
+		/// thread backs off like the backoff strategy before blocking again.
+		blocking
+	};
+
+	Strategy strategy = Strategy::backoff;
+	size_t spin_probes = 10000;
+	size_t yield_probes = 1000;
+	std::chrono::microseconds hybrid_sleep{50};
+	std::chrono::microseconds min_sleep{1};
+	std::chrono::microseconds max_sleep{10000};
+
+	static PollingPolicy busy_spin() SYMBOL_VISIBLE;
+	static PollingPolicy hybrid() SYMBOL_VISIBLE;
+	static PollingPolicy backoff() SYMBOL_VISIBLE;
+	static PollingPolicy blocking() SYMBOL_VISIBLE;
+
+	/// What a single call to `idle` did
+	struct Idle
+	{
+		/// Time actually spent sleeping, zero if the thread only spun or yielded
+		std::chrono::nanoseconds slept{0};
+		/// Whether the thread slept with the longest period of the strategy
+		bool max_backoff = false;
+	};
+
+	/// Waits according to the strategy after the given number of consecutive empty probes.
+	/// The sleep period of the backoff strategy is advanced in place.
+	Idle idle(size_t empty_probes, std::chrono::microseconds& sleep_period) const SYMBOL_VISIBLE;
+};
+
+/// Where and how the poller thread runs, the default leaves all scheduling to the system
+struct PollerPlacement
+{
+	/// CPUs the poller thread may run on, empty for no restriction
+	std::vector<int> cpus;
+	/// Restricts the poller thread to the CPUs of this NUMA node, intersected with `cpus`
+	std::optional<int> numa_node;
+	/// Runs the poller thread with `SCHED_FIFO` at this priority, zero keeps the default
+	/// scheduler. Usually requires `CAP_SYS_NICE`.
+	int fifo_priority = 0;
+	/// Locks all current and future pages of the whole process into memory with `mlockall`
+	bool lock_memory = false;
+
+	/// Applies the placement to the given thread, the calling thread is not affected
+	/// @throws std::invalid_argument if a CPU number is out of range
+	/// @throws std::runtime_error if a setting cannot be applied
+	void apply(std::thread& thread) const SYMBOL_VISIBLE;
+};
+
+class PollerGroup;
+class NotificationPoller;
+
+/**
+ *  Base of awaitables that suspend a coroutine until notifications of a NotificationPoller
+ *  satisfy a condition or a deadline passes.
+ *  Suspended coroutines are resumed on the thread polling the port, so they should hand
+ *  longer work over to an executor of their own. In a PollerGroup a blocking call, e.g. a
+ *  synchronous register access, stalls all ports of the thread until it returns and may
+ *  wait for a notification only that thread would deliver. Deadlines are checked whenever the
+ *  poller thread wakes up. With the blocking strategy the thread probes and backs off
+ *  instead of blocking while coroutines are suspended, so deadlines are noticed at most
+ *  `max_sleep` late.
+ */
+class NotificationAwaiter
+{
+public:
+	NotificationAwaiter(
+	    NotificationPoller& poller, std::chrono::steady_clock::time_point deadline) SYMBOL_VISIBLE;
+
+	bool await_ready() SYMBOL_VISIBLE;
+	/// Returns false if the condition became true while suspending
+	bool await_suspend(std::coroutine_handle<> handle) SYMBOL_VISIBLE;
+
+protected:
+	/// Returns true once the awaited condition holds. Called on the poller thread while
+	/// the coroutine is suspended, only after `true` the awaiter is resumed.
+	virtual bool try_complete() = 0;
+	/// Whether the awaiter was resumed because of its deadline
+	bool expired() const SYMBOL_VISIBLE;
+	/// The deadline the awaiter was created with
+	std::chrono::steady_clock::time_point deadline() const SYMBOL_VISIBLE;
+	/// Consumes a register response without waiting or reporting errors
+	bool take_response() SYMBOL_VISIBLE;
+	/// Quad words announced but not yet consumed
+	uint64_t pending_packets() const SYMBOL_VISIBLE;
+
+	NotificationPoller& m_poller;
+
+private:
+	std::chrono::steady_clock::time_point m_deadline;
+	std::coroutine_handle<> m_handle;
+	bool m_expired = false;
+
+	/// Whether the coroutine can continue, on completion or a stored poller error
+	bool done();
+
+	friend class NotificationPoller;
+	friend class PollerGroup;
+};
+
+/**
+ *  Dispatches the notifications of one RMA port to handlers registered per notification
+ *  class. Ring buffer packets (class 0xca) and register responses (class 0x0) are
+ *  handled by built-in counters consumed by the buffers and the Endpoint.
+ *  Setting or clearing the handler of one of these classes retires its counter: its
+ *  consuming calls throw std::logic_error, and its notifications neither make
+ *  `event_fd()` readable nor are stamped for the latency histograms. The consumer of
+ *  responses may still report their latencies with `record_response_latency()`.
+ *  The port is either polled by a thread of its own or by a shared PollerGroup.
+ *
+ *  Errors while dispatching, including notifications of a class without handler, never
+ *  stop the poller. The first one is stored and rethrown by the next consuming call.
+ */
 class NotificationPoller
 {
+public:
+	/// Counters describing the poller thread so far
+	struct Statistics
+	{
+		/// The policy the poller was created with
+		PollingPolicy policy;
+		/// Number of notifications handled
+		uint64_t notifications;
+		/// Number of probes that found no notification
+		uint64_t empty_probes;
+		/// Time the polling thread spent sleeping between probes, shared with all ports of
+		/// the same thread in a PollerGroup
+		std::chrono::nanoseconds sleep_time;
+		/// Number of sleeps with the longest period of the policy, i.e. `max_sleep` for the
+		/// backoff and `hybrid_sleep` for the hybrid strategy
+		uint64_t max_backoff_sleeps;
+		/// CPU time consumed by the poller thread, shared with all ports of the same
+		/// thread in a PollerGroup
+		std::chrono::nanoseconds cpu_time;
+	};
+
+	/// Notification class the poller posts to its own port to wake up a blocked thread
+	constexpr static RMA2_Class wake_class = 0xfe;
+	/// Class of notifications announcing quad words written to a ring buffer
+	constexpr static RMA2_Class packet_class = 0xca;
+	/// Class of notifications acknowledging register file accesses
+	constexpr static RMA2_Class response_class = 0x0;
+
+	/// Called on the poller thread with the full 64 bit payload of every notification of
+	/// a class. Must not block, exceptions are reported to consumers.
+	using Handler = std::function<void(uint64_t payload)>;
+
+	/// Handler adding the masked payload to the counter
+	static Handler count_payload(NotificationCounter& counter, uint64_t mask = ~uint64_t(0))
+	    SYMBOL_VISIBLE;
+	/// Handler adding one to the counter per notification
+	static Handler count_notifications(NotificationCounter& counter) SYMBOL_VISIBLE;
+	/// Handler pushing the payloads into a queue, which must only be popped by one thread.
+	/// Reports an error if the queue is full.
+	static Handler enqueue_payload(SpscQueue<uint64_t>& queue) SYMBOL_VISIBLE;
+
 private:
 	RMA2_Port m_port;
-	uint64_t m_packets{0};
-	uint64_t m_notifications{0};
+	PollingPolicy const m_policy;
+	/// Quad words announced by ring buffer notifications
+	NotificationCounter m_packets;
+	/// Responses to register reads and writes
+	NotificationCounter m_notifications;
+	/// Whether `m_packets` is the handler of packet notifications
+	std::atomic<bool> m_counting_packets{true};
+	/// Whether `m_notifications` is the handler of responses
+	std::atomic<bool> m_counting_responses{true};
+
+	/// Current handler per notification class, read lock-free by the poller thread
+	std::array<std::atomic<Handler const*>, 256> m_handlers{};
+	/// Guards `m_handler_storage` and `m_retired_handlers`
+	std::mutex m_handler_mutex;
+	/// Owns the current handler per notification class
+	std::array<std::unique_ptr<Handler const>, 256> m_handler_storage;
+	/// Replaced handlers the poller thread may still run, with the dispatch generation
+	/// they were replaced in
+	std::vector<std::pair<uint64_t, std::unique_ptr<Handler const>>> m_retired_handlers;
+	/// Odd while the poller thread dispatches a notification, so a replaced handler is
+	/// known to be unused once the generation changed
+	std::atomic<uint64_t> m_dispatch_generation{0};
+
+	/// Whether `m_error` is set
+	std::atomic<bool> m_failed{false};
+	std::mutex m_error_mutex;
+	/// First error while dispatching that has not been reported yet
+	std::exception_ptr m_error;
+
+	/// Owns an eventfd, so it is closed as well if constructing the poller fails
+	class EventFd
+	{
+	public:
+		/// @throws std::runtime_error if the eventfd cannot be created
+		EventFd();
+		~EventFd();
+		/// This class is not copyable
+		EventFd(EventFd const&) = delete;
+		/// This class is not copy-assignable
+		EventFd& operator=(EventFd const&) = delete;
+
+		int get() const;
+
+	private:
+		int m_fd;
+	};
 
-	std::atomic<bool> m_running;
+	/// Readable while packets or responses are pending
+	EventFd m_event_fd;
+	/// Whether `m_event_fd` has been written to since consumers last read it
+	std::atomic<bool> m_event_signalled{false};
+
+	/// Guards `m_awaiters`
+	std::mutex m_awaiter_mutex;
+	/// Suspended coroutines waiting for notifications
+	std::vector<NotificationAwaiter*> m_awaiters;
+	/// Size of `m_awaiters`, lets the poller thread skip the lock while none is waiting
+	std::atomic<size_t> m_awaiter_count{0};
+
+	std::atomic<uint64_t> m_handled{0};
+	std::atomic<uint64_t> m_empty_probes{0};
+	std::atomic<uint64_t> m_sleep_ns{0};
+	std::atomic<uint64_t> m_max_backoff_sleeps{0};
+
+	std::atomic<bool> m_measure_latency{false};
+	/// Probe time of the oldest unconsumed packet notification in steady clock
+	/// nanoseconds, zero if none is pending or measurement is disabled
+	std::atomic<int64_t> m_packets_pending_since{0};
+	/// Probe time of the oldest unconsumed response, see `m_packets_pending_since`
+	std::atomic<int64_t> m_response_pending_since{0};
+	LatencyHistogram m_packet_latency;
+	LatencyHistogram m_response_latency;
+
+	/// Connection of the port to itself, used to wake up the blocking strategy
+	RMA2_Handle m_wake_handle = nullptr;
+	/// The group polling the port instead of an own thread
+	PollerGroup* m_group = nullptr;
+	std::atomic<bool> m_running{false};
 	std::thread m_thread;
-	std::mutex m_mutex;
-	std::condition_variable m_cv;
+	clockid_t m_cpu_clock;
 
 	void poll_notifications();
+	/// Handles at most one notification, returns false if none was pending
+	bool poll_once(bool block);
+	/// Calls the handler of the class
+	void dispatch(RMA2_Class cls, uint64_t payload);
+	/// Retires the built-in counter of the class, if it has one
+	void stop_counting(RMA2_Class cls);
+	/// Throws if the built-in counter of the class was retired
+	void check_counting(RMA2_Class cls) const;
+	/// Installs the handler of the class and frees replaced handlers no longer in use
+	void replace_handler(RMA2_Class cls, std::unique_ptr<Handler const> handler);
+	/// Adds an idle period of the polling thread to the statistics
+	void count_idle(PollingPolicy::Idle const& idle);
+	/// Records the time since the oldest consumed notification was probed
+	void record_latency(std::atomic<int64_t>& pending_since, LatencyHistogram& histogram);
+	/// Stores the current exception unless an earlier one is pending
+	void fail(std::exception_ptr error);
+	/// Makes the event file descriptor readable
+	void signal_event();
+	/// Resets the event file descriptor before the counters are consumed
+	void acknowledge_event();
+	/// Makes the event file descriptor readable again if anything is still pending
+	void resignal_event();
+	/// Resumes all awaiters that completed or expired
+	void service_awaiters();
+	/// Moves all awaiters that completed or expired to `resumable` without resuming them
+	void collect_awaiters(std::vector<NotificationAwaiter*>& resumable);
+	/// Resumes the collected awaiters and clears the list
+	static void resume_awaiters(std::vector<NotificationAwaiter*>& resumable);
+	/// Resumes all awaiters as expired when polling stops
+	void expire_awaiters();
+	/// Registers a suspended awaiter, returns false if it completed in the meantime
+	bool suspend(NotificationAwaiter& awaiter);
+	/// Stops and joins the poller thread or leaves the group
+	void stop();
+
+	friend class PollerGroup;
+	friend class NotificationAwaiter;
 
 public:
-	NotificationPoller(RMA2_Port p) SYMBOL_VISIBLE;
+	/// Starts the poller thread on the given port
+	/// @throws std::runtime_error if the placement cannot be applied
+	NotificationPoller(
+	    RMA2_Port p, PollingPolicy policy = {}, PollerPlacement const& placement = {})
+	    SYMBOL_VISIBLE;
+	/// Registers the port with the group instead of starting a thread.
+	/// The group must outlive the poller.
+	NotificationPoller(RMA2_Port p, PollerGroup& group) SYMBOL_VISIBLE;
 	~NotificationPoller() SYMBOL_VISIBLE;
 
+	PollingPolicy const& policy() const SYMBOL_VISIBLE;
+	Statistics statistics() const SYMBOL_VISIBLE;
+
+	/// Handles notifications of the class with the handler, replacing any previous one.
+	/// A replaced handler may still be running when this returns. It is freed by a later
+	/// `set_handler` or `clear_handler` once the poller thread finished with it, or on
+	/// destruction.
+	/// @throws std::invalid_argument for the reserved `wake_class`
+	void set_handler(RMA2_Class cls, Handler handler) SYMBOL_VISIBLE;
+	/// Removes the handler, later notifications of the class are reported as errors
+	void clear_handler(RMA2_Class cls) SYMBOL_VISIBLE;
+	/// Rethrows the first error that occurred while dispatching, if any, and clears it
+	void rethrow_error() SYMBOL_VISIBLE;
+
+	/**
+	 *  Enables or disables measuring the latency from probing a packet or response
+	 *  notification to the consuming call returning it. Each consuming call records the
+	 *  latency of the oldest notification it consumed, so the histograms show the time
+	 *  spent in the poller's backoff and the hand-off to the consumer, not in the network.
+	 *  Enabling clears both histograms. Disabled by default, as it reads the clock for
+	 *  every notification.
+	 */
+	void set_latency_measurement(bool enabled) SYMBOL_VISIBLE;
+	/// Latencies of consumed ring buffer packets, see `set_latency_measurement`
+	LatencyHistogram const& packet_latency() const SYMBOL_VISIBLE;
+	/// Latencies of consumed register responses, see `set_latency_measurement`
+	LatencyHistogram const& response_latency() const SYMBOL_VISIBLE;
+	/// Whether latencies are measured, see `set_latency_measurement`
+	bool latency_measurement() const SYMBOL_VISIBLE;
+	/// Records the latency of a response consumed through a custom handler of the
+	/// response class, e.g. by the Endpoint. Ignored while measurement is disabled.
+	void record_response_latency(std::chrono::nanoseconds latency) SYMBOL_VISIBLE;
+
+	/**
+	 *  Non-blocking file descriptor for `epoll`, `poll` or `select`.
+	 *  It becomes readable when packets or responses are pending or an error occurred
+	 *  while dispatching, and is reset by the consuming calls. Readiness may be spurious,
+	 *  so event loops should use the non-blocking `try_` variants afterwards.
+	 *  The descriptor is owned by the poller and must not be read or closed.
+	 */
+	int event_fd() const SYMBOL_VISIBLE;
+
+	/// Consumes one register response
+	/// @throws any error that occurred while dispatching
+	/// @throws std::logic_error if the class has a custom handler
 	bool consume_response(std::chrono::milliseconds) SYMBOL_VISIBLE;
-	uint64_t consume_packets(std::chrono::milliseconds) SYMBOL_VISIBLE;
+	/// Consumes all quad words announced by ring buffer notifications
+	/// @throws any error that occurred while dispatching
+	/// @throws std::logic_error if the class has a custom handler
+	uint64_t consume_packets(std::chrono::nanoseconds) SYMBOL_VISIBLE;
+	/// Consumes one register response if one is pending, without waiting
+	/// @throws any error that occurred while dispatching
+	/// @throws std::logic_error if the class has a custom handler
+	bool try_consume_response() SYMBOL_VISIBLE;
+	/// Consumes all quad words announced so far, without waiting
+	/// @throws any error that occurred while dispatching
+	/// @throws std::logic_error if the class has a custom handler
+	uint64_t try_consume_packets() SYMBOL_VISIBLE;
+
+	/// Awaitable completing with the next register response or at the deadline
+	class ResponseAwaiter : public NotificationAwaiter
+	{
+	public:
+		using NotificationAwaiter::NotificationAwaiter;
+		/// Returns false if the deadline passed without a response
+		/// @throws any error that occurred while dispatching
+		bool await_resume() SYMBOL_VISIBLE;
 
-	// Used to restrict process to single CPU to avoid notification latency issues.
-	cpu_set_t cpu;
+	private:
+		bool try_complete() override;
+	};
+	/// Suspends the awaiting coroutine until a register response arrives
+	/// @throws std::logic_error if responses have a custom handler
+	ResponseAwaiter next_response(std::chrono::steady_clock::time_point deadline)
+	    SYMBOL_VISIBLE;
 };
 
 } // namespace nhtl_extoll
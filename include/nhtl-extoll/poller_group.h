@@ -0,0 +1,77 @@
+#pragma once
+#include "hate/visibility.h"
+#include "nhtl-extoll/notification_poller.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nhtl_extoll {
+
+/**
+ *  A fixed number of threads polling the notifications of many RMA ports.
+ *  Each NotificationPoller created with a group is assigned to the thread servicing the
+ *  fewest ports. A thread probes its ports round-robin and only idles according to the
+ *  policy once a whole sweep found no notification, so the CPU load depends on the number
+ *  of threads, not on the number of ports.
+ */
+class PollerGroup
+{
+public:
+	/// Starts the given number of threads
+	/// @throws std::invalid_argument if no thread or the blocking strategy is requested,
+	/// a blocking thread could only wait for a single port
+	/// @throws std::runtime_error if the placement cannot be applied
+	explicit PollerGroup(
+	    size_t threads = 1, PollingPolicy policy = {}, PollerPlacement const& placement = {})
+	    SYMBOL_VISIBLE;
+	/// Stops all threads, all pollers of the group must have been destroyed before
+	~PollerGroup() SYMBOL_VISIBLE;
+	/// This class is not copyable
+	PollerGroup(PollerGroup const&) = delete;
+	/// This class is not copy-assignable
+	PollerGroup& operator=(PollerGroup const&) = delete;
+
+	PollingPolicy const& policy() const SYMBOL_VISIBLE;
+	/// Number of polling threads
+	size_t threads() const SYMBOL_VISIBLE;
+	/// Number of ports currently polled
+	size_t size() const SYMBOL_VISIBLE;
+
+private:
+	/// A thread and the pollers it services
+	struct Worker
+	{
+		/// Guards all members but `thread`, held by the thread for a whole sweep
+		std::mutex mutex;
+		std::vector<NotificationPoller*> pollers;
+		/// Awaiters collected by the last sweep, resumed one by one without the lock
+		std::vector<NotificationAwaiter*> resumable;
+		/// Poller of the awaiter being resumed, nullptr if none
+		NotificationPoller const* resuming = nullptr;
+		/// Notified whenever a resumed coroutine returned to the thread
+		std::condition_variable resumed;
+		std::thread thread;
+	};
+
+	PollingPolicy const m_policy;
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::atomic<bool> m_running{true};
+
+	void run(Worker& worker);
+	/// Resumes the awaiters collected by the last sweep of the worker
+	void resume(Worker& worker);
+	void stop();
+	/// Called by NotificationPoller on construction
+	void add(NotificationPoller& poller);
+	/// Called by NotificationPoller on destruction, no thread accesses it afterwards.
+	/// Waits for a coroutine of the poller being resumed by another thread and returns
+	/// the awaiters of the poller that were collected but not resumed yet.
+	std::vector<NotificationAwaiter*> remove(NotificationPoller& poller);
+
+	friend class NotificationPoller;
+};
+
+} // namespace nhtl_extoll
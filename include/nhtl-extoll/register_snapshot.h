@@ -0,0 +1,76 @@
+#pragma once
+#include "hate/visibility.h"
+#include "rma2.h"
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace nhtl_extoll {
+
+/// Inclusive range of quad word aligned register file addresses
+struct RegisterRange
+{
+	RMA2_NLA first;
+	RMA2_NLA last;
+
+	/// Number of registers in the range
+	size_t size() const SYMBOL_VISIBLE;
+	/// Whether the address lies within the range
+	bool contains(RMA2_NLA address) const SYMBOL_VISIBLE;
+};
+
+/**
+ *  Sparse image of the register files of a range, as returned by
+ *  `Endpoint::snapshot_registers()`. Only registers read as non-zero are stored, all
+ *  others of the range are zero.
+ *  Write-only or unmapped locations read back the data of the last readable location,
+ *  so their values are only meaningful when compared between snapshots.
+ */
+class RegisterSnapshot
+{
+public:
+	/// Value of a single register
+	struct Entry
+	{
+		RMA2_NLA address;
+		uint64_t value;
+	};
+
+	/// Register whose value differs between two snapshots
+	struct Difference
+	{
+		RMA2_NLA address;
+		uint64_t before;
+		uint64_t after;
+	};
+
+	/// Creates a snapshot from the values of all registers of the range in address order
+	/// @throws std::invalid_argument if the number of values does not match the range
+	RegisterSnapshot(
+	    RegisterRange range,
+	    std::span<uint64_t const> values,
+	    std::chrono::system_clock::time_point time = std::chrono::system_clock::now())
+	    SYMBOL_VISIBLE;
+
+	/// The range that was read
+	RegisterRange range() const SYMBOL_VISIBLE;
+	/// When the registers were read
+	std::chrono::system_clock::time_point time() const SYMBOL_VISIBLE;
+	/// All non-zero registers in ascending address order
+	std::span<Entry const> entries() const SYMBOL_VISIBLE;
+	/// Value of the register at the address
+	/// @throws std::out_of_range if the address is not part of the range
+	uint64_t value(RMA2_NLA address) const SYMBOL_VISIBLE;
+
+	/// All registers in both ranges whose values differ from the previous snapshot, in
+	/// ascending address order
+	std::vector<Difference> diff(RegisterSnapshot const& previous) const SYMBOL_VISIBLE;
+
+private:
+	RegisterRange m_range;
+	std::chrono::system_clock::time_point m_time;
+	std::vector<Entry> m_entries;
+};
+
+} // namespace nhtl_extoll
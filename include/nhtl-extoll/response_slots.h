@@ -0,0 +1,76 @@
+#pragma once
+#include "hate/visibility.h"
+#include "nhtl-extoll/buffer.h"
+#include "nhtl-extoll/notification_counter.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace nhtl_extoll {
+
+/**
+ *  Lock-free pool of the slots of the RRA response buffer of a PhysicalBuffer.
+ *  Every outstanding register read owns a slot the Fpga writes its response to, so
+ *  reads of several threads do not overwrite each other's results.
+ *  Slot 0 is never handed out, it is the config response address of the Fpga.
+ *
+ *  The slot of a read whose response is overdue cannot be reused right away, as the Fpga
+ *  may still write it. It is handed to `release_after()` with the ticket of the read and
+ *  returned to the pool once the counter of completed accesses exceeds the ticket.
+ *  Deferring a slot neither locks nor allocates, so it is safe in destructors.
+ */
+class ResponseSlots
+{
+public:
+	/// Slot excluded from the pool
+	constexpr static size_t reserved_slot = 0;
+	/// Number of slots that can be acquired
+	constexpr static size_t size = PhysicalBuffer::response_slots - 1;
+
+	/// Creates a pool with all slots but the reserved one free. Slots passed to
+	/// `release_after()` are returned once `completions` exceeds their ticket, the
+	/// counter must outlive the pool.
+	explicit ResponseSlots(NotificationCounter const* completions = nullptr) SYMBOL_VISIBLE;
+	/// This class is not copyable
+	ResponseSlots(ResponseSlots const&) = delete;
+	/// This class is not copy-assignable
+	ResponseSlots& operator=(ResponseSlots const&) = delete;
+
+	/// Takes a free slot if there is one
+	std::optional<size_t> try_acquire() SYMBOL_VISIBLE;
+	/// Takes up to `slots.size()` free slots, yielding until at least one is free or the
+	/// deadline passed. Returns the number of slots taken, zero at the deadline.
+	size_t acquire(
+	    std::span<size_t> slots,
+	    std::chrono::steady_clock::time_point deadline =
+	        std::chrono::steady_clock::time_point::max()) SYMBOL_VISIBLE;
+	/// Returns a slot to the pool
+	void release(size_t slot) SYMBOL_VISIBLE;
+	/// Returns a slot to the pool once the access with the ticket has completed.
+	/// Only throws for slots that cannot have been acquired.
+	void release_after(size_t slot, uint64_t ticket) SYMBOL_VISIBLE;
+	/// Number of free slots, which may change concurrently
+	size_t available() const SYMBOL_VISIBLE;
+
+private:
+	constexpr static size_t word_bits = 64;
+
+	/// One bit per slot, set while the slot is free
+	std::array<std::atomic<uint64_t>, PhysicalBuffer::response_slots / word_bits> m_free;
+	/// Word to start searching at, spreads concurrent callers over the words
+	std::atomic<size_t> m_next_word{0};
+
+	NotificationCounter const* m_completions;
+	/// One bit per slot, set while the slot waits for the access of its deferred ticket
+	std::array<std::atomic<uint64_t>, PhysicalBuffer::response_slots / word_bits> m_deferred{};
+	/// Ticket per deferred slot, published by setting its bit in `m_deferred`
+	std::array<std::atomic<uint64_t>, PhysicalBuffer::response_slots> m_deferred_ticket{};
+
+	/// Returns the deferred slots whose access has completed
+	void reclaim();
+};
+
+} // namespace nhtl_extoll
@@ -0,0 +1,114 @@
+#pragma once
+#include "hate/visibility.h"
+#include "nhtl-extoll/buffer.h"
+#include "nhtl-extoll/spsc_queue.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+namespace nhtl_extoll {
+
+/**
+ *  Continuously empties a ring buffer from a dedicated thread.
+ *  Received words are collected in batches which are handed to a single consumer
+ *  thread via a bounded lock-free queue. Consumed batches are recycled by the drain,
+ *  so no allocations occur once the batches have grown to their working size.
+ *  Credits are returned to the Fpga by the drain thread, independent of when the
+ *  consumer pulls the batches.
+ *  If the queue is full, e.g. during a burst, further batches are spilled into a
+ *  growable overflow of ordinary host memory, up to a configurable limit. Spilled
+ *  batches keep their order and are handed to the consumer before any newer data.
+ *  Only if the overflow limit is reached, the drain stalls and the Fpga eventually
+ *  applies backpressure.
+ *  While a drain is attached, the ring buffer must not be read by anyone else.
+ */
+class RingBufferDrain
+{
+public:
+	/// Counters describing the drain's activity so far
+	struct Statistics
+	{
+		/// Number of batches handed to the consumer
+		uint64_t batches;
+		/// Number of quad words handed to the consumer
+		uint64_t words;
+		/// Number of times the drain had to wait for the consumer because the queue
+		/// and the overflow were full
+		uint64_t stalls;
+		/// Number of quad words spilled into the overflow
+		uint64_t spilled_words;
+		/// Number of quad words currently held in the overflow
+		uint64_t overflow_words;
+		/// Maximum number of quad words held in the overflow at once
+		uint64_t peak_overflow_words;
+	};
+
+	/// Default number of batches buffered between drain and consumer
+	constexpr static size_t default_queue_capacity = 64;
+
+	/// Starts draining the given ring buffer, buffering at most `queue_capacity` batches.
+	/// If the queue is full, at most `max_overflow_words` quad words are spilled into the
+	/// overflow, zero disables spilling.
+	explicit RingBufferDrain(
+	    RingBuffer& ring,
+	    size_t queue_capacity = default_queue_capacity,
+	    size_t max_overflow_words = 0) SYMBOL_VISIBLE;
+	/// Stops the drain thread. Batches not yet popped are discarded.
+	~RingBufferDrain() SYMBOL_VISIBLE;
+	/// This class is not copyable
+	RingBufferDrain(RingBufferDrain const&) = delete;
+	/// This class is not copy-assignable
+	RingBufferDrain& operator=(RingBufferDrain const&) = delete;
+
+	/**
+	 *  Waits for the oldest batch and swaps it into the given vector.
+	 *  The previous contents of the vector are handed back to the drain for reuse.
+	 *  Returns false if no batch arrived within the timeout.
+	 */
+	bool pop(std::vector<uint64_t>& batch, std::chrono::milliseconds timeout) SYMBOL_VISIBLE;
+	/// Non-blocking version of `pop()`
+	bool try_pop(std::vector<uint64_t>& batch) SYMBOL_VISIBLE;
+
+	/// Returns the current counters
+	Statistics statistics() const SYMBOL_VISIBLE;
+
+private:
+	/// The drained ring buffer
+	RingBuffer& m_ring;
+	/// Batches filled by the drain thread, waiting for the consumer
+	SpscQueue<std::vector<uint64_t>> m_filled;
+	/// Batches handed back by the consumer for reuse
+	SpscQueue<std::vector<uint64_t>> m_recycled;
+	/// Counts the batches in the filled queue to let the consumer block
+	std::counting_semaphore<> m_available{0};
+	/// Batches that did not fit into the filled queue, only accessed by the drain thread
+	std::deque<std::vector<uint64_t>> m_overflow;
+	/// Maximum number of quad words in the overflow
+	size_t const m_max_overflow_words;
+
+	std::atomic<uint64_t> m_batches{0};
+	std::atomic<uint64_t> m_words{0};
+	std::atomic<uint64_t> m_stalls{0};
+	std::atomic<uint64_t> m_spilled_words{0};
+	std::atomic<uint64_t> m_overflow_words{0};
+	std::atomic<uint64_t> m_peak_overflow_words{0};
+
+	std::atomic<bool> m_running{true};
+	std::thread m_thread;
+
+	void drain();
+	/// Hands a batch to the consumer, returns false if the queue is full
+	bool publish(std::vector<uint64_t>& batch);
+	/// Appends a batch to the overflow, returns false if it exceeds the limit
+	bool spill(std::vector<uint64_t>& batch);
+	/// Moves as many overflow batches as fit into the queue, returns true if none are left
+	bool flush_overflow();
+	/// Takes the popped batch out of the filled queue, recycling the previous one
+	void exchange(std::vector<uint64_t>& batch);
+};
+
+} // namespace nhtl_extoll
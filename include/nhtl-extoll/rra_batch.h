@@ -0,0 +1,86 @@
+#pragma once
+#include "hate/visibility.h"
+#include "nhtl-extoll/connection.h"
+#include "rma2.h"
+#include <cstdint>
+#include <deque>
+
+namespace nhtl_extoll {
+
+/**
+ *  Pipelines remote register file writes to one Endpoint.
+ *  Writes are posted back to back while at most `max_in_flight` of them await their
+ *  completion notification, so a sequence of writes costs about one network round trip
+ *  instead of one per write.
+ *  @code
+ *  RraBatch batch(endpoint);
+ *  batch.write<TraceBufferStart>({address});
+ *  batch.write<TraceBufferSize>({capacity});
+ *  batch.flush();
+ *  @endcode
+ *  A batch must only be used by one thread, other threads may access registers of the
+ *  same Endpoint concurrently.
+ */
+class RraBatch
+{
+public:
+	/// Default number of writes awaiting completion at the same time
+	constexpr static size_t default_max_in_flight = 16;
+
+	/// Creates an empty batch for the endpoint, which must outlive it
+	/// @throws std::invalid_argument if `max_in_flight` is zero
+	explicit RraBatch(Endpoint& endpoint, size_t max_in_flight = default_max_in_flight)
+	    SYMBOL_VISIBLE;
+	/// Waits for all writes still in flight, errors are only reported on `std::cerr`
+	~RraBatch() SYMBOL_VISIBLE;
+	/// This class is not copyable
+	RraBatch(RraBatch const&) = delete;
+	/// This class is not copy-assignable
+	RraBatch& operator=(RraBatch const&) = delete;
+
+	/// Posts a write of the register file, cf. `Endpoint::rra_write()`
+	template <typename RF>
+	void write(RF const& rf)
+	{
+		static_assert(RF::rf_address >= 0, "register file address must be positive!");
+		static_assert(RF::rf_address <= Endpoint::max_address, "register file address too large!");
+		static_assert(RF::writable, "register file must be writable!");
+
+		write(RF::rf_address, rf.raw);
+	}
+
+	/// Posts an untyped write, first waiting for the oldest write in flight if the limit
+	/// is reached
+	/// @throws FailedToWrite for this address if the write cannot be posted, or for the
+	/// address of an earlier write that did not complete within `Endpoint::rra_timeout`
+	void write(RMA2_NLA address, uint64_t value) SYMBOL_VISIBLE;
+
+	/// Waits until all posted writes completed
+	/// @throws FailedToWrite for the address of the oldest write that did not complete
+	/// within `Endpoint::rra_timeout`
+	void flush() SYMBOL_VISIBLE;
+
+	/// Number of posted writes still awaiting completion
+	size_t in_flight() const SYMBOL_VISIBLE;
+
+private:
+	Endpoint& m_endpoint;
+	size_t m_max_in_flight;
+
+	/// A posted write awaiting completion
+	struct Write
+	{
+		RMA2_NLA address;
+		/// Ticket of the write in the posting order of the Endpoint
+		uint64_t ticket;
+	};
+
+	/// Writes in flight in posting order, completions arrive in this order
+	std::deque<Write> m_in_flight;
+
+	/// Waits for the completion of the oldest write in flight.
+	/// On a timeout all writes in flight are abandoned.
+	void complete_oldest();
+};
+
+} // namespace nhtl_extoll
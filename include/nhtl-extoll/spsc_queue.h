@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace nhtl_extoll {
+
+/**
+ *  Bounded lock-free queue for exactly one producer and one consumer thread.
+ *  Elements are move-assigned into preallocated slots, so pushing and popping
+ *  never allocates once the queue is constructed.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+	/// Creates a queue holding at most the given number of elements
+	explicit SpscQueue(size_t capacity) : m_slots(capacity + 1) {}
+
+	/// This class is not copyable
+	SpscQueue(SpscQueue const&) = delete;
+	/// This class is not copy-assignable
+	SpscQueue& operator=(SpscQueue const&) = delete;
+
+	/// Moves the value into the queue, only to be called by the producer.
+	/// Returns false and leaves the value untouched if the queue is full.
+	bool try_push(T&& value)
+	{
+		size_t const tail = m_tail.load(std::memory_order_relaxed);
+		size_t const next = increment(tail);
+		if (next == m_cached_head) {
+			m_cached_head = m_head.load(std::memory_order_acquire);
+			if (next == m_cached_head) {
+				return false;
+			}
+		}
+		m_slots[tail] = std::move(value);
+		m_tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	/// Moves the oldest element into the value, only to be called by the consumer.
+	/// Returns false and leaves the value untouched if the queue is empty.
+	bool try_pop(T& value)
+	{
+		size_t const head = m_head.load(std::memory_order_relaxed);
+		if (head == m_cached_tail) {
+			m_cached_tail = m_tail.load(std::memory_order_acquire);
+			if (head == m_cached_tail) {
+				return false;
+			}
+		}
+		value = std::move(m_slots[head]);
+		m_head.store(increment(head), std::memory_order_release);
+		return true;
+	}
+
+	/// Number of elements in the queue, only exact if called by producer or consumer
+	size_t size() const
+	{
+		size_t const head = m_head.load(std::memory_order_acquire);
+		size_t const tail = m_tail.load(std::memory_order_acquire);
+		return tail >= head ? tail - head : tail + m_slots.size() - head;
+	}
+
+	/// Maximum number of elements in the queue
+	size_t capacity() const
+	{
+		return m_slots.size() - 1;
+	}
+
+private:
+	/// Assumed size of a cache line, producer and consumer state are kept apart
+	constexpr static size_t cache_line_bt = 64;
+
+	size_t increment(size_t index) const
+	{
+		return index + 1 == m_slots.size() ? 0 : index + 1;
+	}
+
+	/// Storage with one slot kept free to distinguish a full from an empty queue
+	std::vector<T> m_slots;
+	/// Index of the oldest element, written by the consumer
+	alignas(cache_line_bt) std::atomic<size_t> m_head{0};
+	/// The consumer's last observed tail
+	size_t m_cached_tail{0};
+	/// Index of the next free slot, written by the producer
+	alignas(cache_line_bt) std::atomic<size_t> m_tail{0};
+	/// The producer's last observed head
+	size_t m_cached_head{0};
+};
+
+} // namespace nhtl_extoll
@@ -0,0 +1,215 @@
+#pragma once
+#include "hate/visibility.h"
+#include "rma2.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace nhtl_extoll {
+
+/**
+ *  Container format for recorded ring buffer data.
+ *
+ *  A trace file consists of a TraceFileHeader padded to one page, a sequence of chunks
+ *  and an index followed by a TraceFileFooter at the very end of the file.
+ *  Each chunk starts with a TraceChunkHeader followed by the recorded quad words and
+ *  zero padding up to the next page boundary, so chunks can be written with direct I/O
+ *  and accessed in place after mapping the file. The index holds one TraceIndexEntry per
+ *  chunk to jump to a chunk or a time range without scanning the file.
+ *  All values are stored in host byte order.
+ */
+struct TraceFileHeader
+{
+	/// "NHTLTRCE"
+	constexpr static uint64_t magic_value = 0x454352544c54484e;
+	/// Version of the format described here
+	constexpr static uint32_t current_version = 1;
+
+	uint64_t magic;
+	uint32_t version;
+	/// Alignment of all chunks in bytes
+	uint32_t alignment_bt;
+	/// Identifier of the recorded ring buffer, e.g. RingBuffer::trace_identifier
+	uint64_t identifier;
+	/// Node id of the Fpga the data was received from
+	uint16_t node;
+	uint16_t reserved0;
+	uint32_t reserved1;
+	uint64_t reserved2[4];
+};
+static_assert(sizeof(TraceFileHeader) == 64);
+
+/// Header in front of the quad words of every chunk
+struct TraceChunkHeader
+{
+	/// "NHTLCHNK"
+	constexpr static uint64_t magic_value = 0x4b4e48434c54484e;
+
+	uint64_t magic;
+	/// Number of the chunk, continuous across rotated files of a recording
+	uint64_t sequence;
+	/// Host time the first word of the chunk was received in ns since the Unix epoch
+	int64_t timestamp_ns;
+	/// Number of recorded quad words in the chunk
+	uint64_t words;
+	/// Size of the chunk on disk including header and padding in bytes
+	uint64_t size_bt;
+	/// Node id of the Fpga the data was received from
+	uint16_t node;
+	uint16_t reserved0;
+	uint32_t reserved1;
+	/// Identifier of the recorded ring buffer
+	uint64_t identifier;
+	uint64_t reserved2;
+};
+static_assert(sizeof(TraceChunkHeader) == 64);
+
+/// Entry of the index at the end of a trace file
+struct TraceIndexEntry
+{
+	/// Offset of the chunk header from the start of the file in bytes
+	uint64_t offset;
+	uint64_t sequence;
+	int64_t timestamp_ns;
+	uint64_t words;
+};
+static_assert(sizeof(TraceIndexEntry) == 32);
+
+/// Footer at the very end of a finished trace file
+struct TraceFileFooter
+{
+	/// "NHTLINDX"
+	constexpr static uint64_t magic_value = 0x58444e494c54484e;
+
+	/// Offset of the first index entry from the start of the file in bytes
+	uint64_t index_offset;
+	/// Number of index entries
+	uint64_t entries;
+	uint64_t reserved;
+	uint64_t magic;
+};
+static_assert(sizeof(TraceFileFooter) == 32);
+
+/**
+ *  Writes a trace file chunk by chunk.
+ *  The index and footer are written when the writer is finished or destroyed.
+ */
+class TraceFileWriter
+{
+public:
+	/// Alignment of chunks in the file and of chunk memory for direct I/O in bytes
+	constexpr static size_t alignment_bt = 4096;
+	/// Space reserved in front of the words of a chunk for its header in bytes
+	constexpr static size_t chunk_header_size_bt = sizeof(TraceChunkHeader);
+
+	/// Creates the file and writes its header.
+	/// With `direct_io`, the page cache is bypassed if the file system supports it.
+	/// @throws std::runtime_error if the file cannot be created
+	TraceFileWriter(
+	    std::filesystem::path const& path,
+	    RMA2_Nodeid node,
+	    uint64_t identifier,
+	    bool direct_io = false,
+	    uint64_t first_sequence = 0) SYMBOL_VISIBLE;
+	/// Finishes the file, errors are printed but not thrown
+	~TraceFileWriter() SYMBOL_VISIBLE;
+	/// This class is not copyable
+	TraceFileWriter(TraceFileWriter const&) = delete;
+	/// This class is not copy-assignable
+	TraceFileWriter& operator=(TraceFileWriter const&) = delete;
+
+	/// Size of a chunk holding the given number of quad words on disk in bytes
+	static size_t chunk_size_bt(size_t words) SYMBOL_VISIBLE;
+
+	/**
+	 *  Writes a chunk prepared in place without copying.
+	 *  The memory must be aligned to `alignment_bt`, span at least `chunk_size_bt(words)`
+	 *  bytes and hold the words after the first `chunk_header_size_bt` bytes. Header and
+	 *  padding are filled in by the writer.
+	 *  @throws std::runtime_error if writing fails
+	 */
+	void write_chunk(
+	    void* chunk, size_t words, std::chrono::system_clock::time_point received) SYMBOL_VISIBLE;
+	/// Copies the given words into a new chunk and writes it
+	void append(
+	    std::span<uint64_t const> words,
+	    std::chrono::system_clock::time_point received = std::chrono::system_clock::now())
+	    SYMBOL_VISIBLE;
+	/// Writes the index and the footer and closes the file
+	void finish() SYMBOL_VISIBLE;
+
+	/// Bytes written to the file so far
+	size_t size_bt() const SYMBOL_VISIBLE;
+	/// Sequence number of the next chunk
+	uint64_t next_sequence() const SYMBOL_VISIBLE;
+
+private:
+	int m_fd = -1;
+	bool m_direct = false;
+	size_t m_size_bt = 0;
+	uint64_t m_sequence;
+	RMA2_Nodeid m_node;
+	uint64_t m_identifier;
+	std::vector<TraceIndexEntry> m_index;
+	/// Aligned memory used by `append()`
+	std::unique_ptr<uint64_t[], void (*)(void*)> m_scratch;
+	size_t m_scratch_size_bt = 0;
+
+	void write_fully(void const* data, size_t size_bt);
+};
+
+/// A chunk of a mapped trace file
+struct TraceChunk
+{
+	TraceChunkHeader const& header;
+	/// The recorded quad words, pointing directly into the mapped file
+	std::span<uint64_t const> words;
+};
+
+/**
+ *  Maps a trace file read-only and gives zero-copy access to its chunks.
+ *  If the file was not finished, e.g. because the recording process crashed, the index
+ *  is rebuilt by walking the chunk headers.
+ */
+class TraceFileReader
+{
+public:
+	/// Maps the file and validates header and index.
+	/// An index with entries outside of the file is rebuilt like that of an unfinished file.
+	/// @throws std::runtime_error if the file cannot be mapped or is no trace file
+	explicit TraceFileReader(std::filesystem::path const& path) SYMBOL_VISIBLE;
+	~TraceFileReader() SYMBOL_VISIBLE;
+	/// This class is not copyable
+	TraceFileReader(TraceFileReader const&) = delete;
+	/// This class is not copy-assignable
+	TraceFileReader& operator=(TraceFileReader const&) = delete;
+
+	TraceFileHeader const& header() const SYMBOL_VISIBLE;
+	/// The index of all chunks ordered by sequence number
+	std::span<TraceIndexEntry const> index() const SYMBOL_VISIBLE;
+	/// Number of chunks
+	size_t size() const SYMBOL_VISIBLE;
+	/// Returns the chunk at the given position of the index
+	/// @throws std::out_of_range if the position is out of range
+	TraceChunk chunk(size_t position) const SYMBOL_VISIBLE;
+	/// Position of the first chunk received at or after the given time.
+	/// Assumes the host clock did not jump backwards during the recording.
+	size_t find(std::chrono::system_clock::time_point time) const SYMBOL_VISIBLE;
+	/// Whether the index had to be rebuilt because the file was not finished
+	bool recovered() const SYMBOL_VISIBLE;
+
+private:
+	void* m_map = nullptr;
+	size_t m_size_bt = 0;
+	std::span<TraceIndexEntry const> m_index;
+	/// Index rebuilt from the chunk headers of an unfinished file
+	std::vector<TraceIndexEntry> m_recovered_index;
+	bool m_recovered = false;
+
+	void recover_index();
+};
+
+} // namespace nhtl_extoll
@@ -0,0 +1,159 @@
+#pragma once
+#include "hate/visibility.h"
+#include "nhtl-extoll/buffer.h"
+#include "nhtl-extoll/spsc_queue.h"
+#include "nhtl-extoll/trace_file.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+namespace nhtl_extoll {
+
+/// Configuration of a TraceRecorder
+struct TraceRecorderOptions
+{
+	/// Layout of the written files
+	enum class Format
+	{
+		/// The received quad words back to back without any framing
+		raw,
+		/// Chunks with headers and an index, see TraceFileHeader and TraceFileReader
+		indexed
+	};
+
+	/// The file to record to. With rotation enabled, an index is appended to the name.
+	std::filesystem::path path;
+	/// Size of each in-flight buffer in bytes, must be a multiple of 4096
+	size_t buffer_size_bt = 4 * 1024 * 1024;
+	/// Number of buffers shared between ring buffer draining and disk writes
+	size_t buffers = 8;
+	/// Whether to bypass the page cache with `O_DIRECT`.
+	/// Silently falls back to buffered writes if the file system does not support it.
+	bool direct_io = true;
+	/// Starts a new file once the current one would exceed this size, zero disables rotation
+	size_t max_file_size_bt = 0;
+	/// Whether to discard received words instead of stalling the ring buffer if all
+	/// buffers are waiting to be written
+	bool drop_on_overrun = false;
+	Format format = Format::raw;
+	/// Node id stored in indexed files, e.g. from `Endpoint::get_node()`
+	RMA2_Nodeid node = 0;
+	/// Ring buffer identifier stored in indexed files
+	uint64_t identifier = RingBuffer::trace_identifier;
+};
+
+/**
+ *  Streams every quad word received by a ring buffer to disk.
+ *  One thread drains the ring buffer into a pool of page-aligned buffers while a second
+ *  thread writes completely filled buffers to the file, so disk I/O overlaps with the
+ *  next drain of the ring buffer. Partially filled buffers are written when recording
+ *  stops. In the indexed format, every buffer becomes one chunk of the file.
+ *  While a recorder is attached, the ring buffer must not be read by anyone else.
+ */
+class TraceRecorder
+{
+public:
+	/// Counters describing the recording so far
+	struct Statistics
+	{
+		/// Number of quad words received from the ring buffer
+		uint64_t received_words;
+		/// Number of bytes written to disk
+		uint64_t written_bt;
+		/// Number of quad words discarded because all buffers were in flight
+		uint64_t dropped_words;
+		/// Number of files written to, including the current one
+		uint64_t files;
+		/// Time since the recording started
+		std::chrono::nanoseconds elapsed;
+
+		/// Average write throughput in bytes per second
+		double throughput_bt_per_s() const
+		{
+			return elapsed.count() > 0 ? double(written_bt) * 1e9 / double(elapsed.count()) : 0.;
+		}
+	};
+
+	/// Starts recording the given ring buffer
+	/// @throws std::invalid_argument if the buffer size is no multiple of the page size
+	/// @throws std::runtime_error if the file cannot be opened
+	TraceRecorder(RingBuffer& ring, TraceRecorderOptions options) SYMBOL_VISIBLE;
+	/// Stops recording, errors of the writer thread are discarded
+	~TraceRecorder() SYMBOL_VISIBLE;
+	/// This class is not copyable
+	TraceRecorder(TraceRecorder const&) = delete;
+	/// This class is not copy-assignable
+	TraceRecorder& operator=(TraceRecorder const&) = delete;
+
+	/// Stops draining, writes all remaining words and closes the file.
+	/// @throws std::runtime_error if writing to disk failed at any point
+	void stop() SYMBOL_VISIBLE;
+
+	/// Returns the current counters
+	Statistics statistics() const SYMBOL_VISIBLE;
+
+private:
+	/// A filled buffer handed to the writer
+	struct Filled
+	{
+		/// Index of the buffer in the pool
+		size_t index;
+		/// Number of quad words in the buffer
+		size_t words;
+		/// Host time the first word of the buffer was received
+		std::chrono::system_clock::time_point received;
+	};
+	/// Marks the end of the recording in the filled queue
+	constexpr static size_t stop_index = static_cast<size_t>(-1);
+
+	RingBuffer& m_ring;
+	TraceRecorderOptions const m_options;
+	size_t const m_buffer_size_qw;
+	/// Offset of the received words in each buffer, leaving room for a chunk header
+	size_t const m_data_offset_qw;
+	/// Page-aligned buffers
+	std::vector<std::unique_ptr<uint64_t[], void (*)(void*)>> m_buffers;
+	/// Buffers waiting to be written
+	SpscQueue<Filled> m_filled;
+	/// Buffers ready to be filled
+	SpscQueue<size_t> m_free;
+	std::counting_semaphore<> m_filled_available{0};
+	std::counting_semaphore<> m_free_available{0};
+
+	/// The current file in the indexed format
+	std::optional<TraceFileWriter> m_file_writer;
+	/// The current file in the raw format
+	int m_fd = -1;
+	/// Whether the current file was opened with `O_DIRECT`
+	bool m_direct = false;
+	/// Bytes written to the current file
+	size_t m_file_size_bt = 0;
+	/// Error of the writer thread, rethrown by `stop()`
+	std::exception_ptr m_error;
+
+	std::chrono::steady_clock::time_point const m_start;
+	std::atomic<uint64_t> m_received_words{0};
+	std::atomic<uint64_t> m_written_bt{0};
+	std::atomic<uint64_t> m_dropped_words{0};
+	std::atomic<uint64_t> m_files{0};
+
+	std::atomic<bool> m_running{true};
+	std::thread m_receiver;
+	std::thread m_writer;
+
+	void receive();
+	void write();
+	/// Closes the current file, if any, and opens the next one
+	void open_next_file();
+	/// Writes the given bytes to the current file
+	void write_fully(char const* data, size_t size_bt);
+};
+
+} // namespace nhtl_extoll
@@ -3,21 +3,113 @@
 #include "nhtl-extoll/exception.h"
 #include "nhtl-extoll/throw_on_error.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
 #include <chrono>
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
+#include <linux/memfd.h>
+#include <linux/mman.h>
 #include <pmap.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 namespace nhtl_extoll {
 
-PhysicalBuffer::PhysicalBuffer()
+namespace {
+
+/// Number of quad words in a cache line
+constexpr size_t cache_line_qw = 64 / sizeof(uint64_t);
+/// Number of quad words to prefetch ahead of the read pointer
+constexpr size_t prefetch_distance_qw = 16 * cache_line_qw;
+
+/// Size of the last level cache in bytes, zero if unknown
+size_t last_level_cache_size_bt()
+{
+	static size_t const size = [] {
+		for (int level : {_SC_LEVEL3_CACHE_SIZE, _SC_LEVEL2_CACHE_SIZE}) {
+			long const size = sysconf(level);
+			if (size > 0) {
+				return size_t(size);
+			}
+		}
+		return size_t(0);
+	}();
+	return size;
+}
+
+/**
+ *  Copies a contiguous segment of quad words out of a ring buffer.
+ *  The source is prefetched ahead of the copy cache line by cache line. If requested,
+ *  the destination is written with non-temporal stores bypassing the cache.
+ */
+void copy_words(uint64_t* destination, uint64_t const* source, size_t words, bool non_temporal)
+{
+	if (words == 0) {
+		return;
+	}
+
+	size_t i = 0;
+#if defined(__SSE2__)
+	if (non_temporal) {
+		// Streaming stores require 16B alignment of the destination
+		if (reinterpret_cast<uintptr_t>(destination) % sizeof(__m128i) != 0) {
+			destination[0] = source[0];
+			i = 1;
+		}
+		for (; i + cache_line_qw <= words; i += cache_line_qw) {
+			__builtin_prefetch(source + i + prefetch_distance_qw, 0, 0);
+			for (size_t j = 0; j < cache_line_qw; j += 2) {
+				__m128i const data =
+				    _mm_loadu_si128(reinterpret_cast<__m128i const*>(source + i + j));
+				_mm_stream_si128(reinterpret_cast<__m128i*>(destination + i + j), data);
+			}
+		}
+		_mm_sfence();
+	}
+#endif
+	for (; i + cache_line_qw <= words; i += cache_line_qw) {
+		__builtin_prefetch(source + i + prefetch_distance_qw, 0, 0);
+		std::memcpy(destination + i, source + i, cache_line_qw * sizeof(uint64_t));
+	}
+	std::memcpy(destination + i, source + i, (words - i) * sizeof(uint64_t));
+}
+
+/// Copies all segments of a view into contiguous memory
+void copy_view(uint64_t* destination, RingBuffer::View const& view)
+{
+	bool const non_temporal = view.size() * sizeof(uint64_t) > last_level_cache_size_bt() &&
+	                          last_level_cache_size_bt() != 0;
+	copy_words(destination, view.first.data(), view.first.size(), non_temporal);
+	copy_words(
+	    destination + view.first.size(), view.second.data(), view.second.size(), non_temporal);
+}
+
+/// Restricts a view to at most the given number of quad words from its front
+RingBuffer::View front(RingBuffer::View view, size_t words)
 {
+	view.first = view.first.first(std::min(view.first.size(), words));
+	view.second = view.second.first(std::min(view.second.size(), words - view.first.size()));
+	return view;
+}
+
+} // namespace
+
+PhysicalBuffer::PhysicalBuffer(size_t send_pages) : m_pages(send_pages + 1)
+{
+	if (m_pages > max_pages) {
+		throw std::invalid_argument("Send buffer must not exceed 1023 pages.");
+	}
+
 	int const page_size = 4096;
 	int ret = sysconf(_SC_PAGESIZE);
 	if (ret != page_size) {
@@ -39,7 +131,7 @@ PhysicalBuffer::PhysicalBuffer()
 	}
 
 	// set size
-	ret = ioctl(pmap_fd, PMAP_IOCTL_SET_SIZE, pages * page_size);
+	ret = ioctl(pmap_fd, PMAP_IOCTL_SET_SIZE, m_pages * page_size);
 	if (ret < 0) {
 		std::cerr << "pmap ioctl PMAP_IOCTL_SET_TYPE failed: " << std::strerror(errno);
 		throw std::runtime_error("Failed to set buffer size.");
@@ -48,7 +140,7 @@ PhysicalBuffer::PhysicalBuffer()
 	// mmap the buffer
 	void* map_address = mmap(
 	    0,                      /* preferred start  */
-	    pages * page_size,      /* length in bytes  */
+	    m_pages * page_size,    /* length in bytes  */
 	    PROT_READ | PROT_WRITE, /* protection flags */
 	    MAP_SHARED,             /* mapping flags    */
 	    pmap_fd,                /* file descriptor  */
@@ -58,7 +150,7 @@ PhysicalBuffer::PhysicalBuffer()
 		std::cerr << "Physcial buffer mmap failed: " << std::strerror(errno);
 		throw std::runtime_error("Failed to mmap buffer.");
 	}
-	m_buffer = new (map_address) std::array<uint64_t, pages * 512>;
+	m_buffer = static_cast<uint64_t*>(map_address);
 
 	// get physical address
 	ret = ioctl(pmap_fd, PMAP_IOCTL_GET_PADDR, &m_physical_address);
@@ -70,7 +162,7 @@ PhysicalBuffer::PhysicalBuffer()
 
 PhysicalBuffer::~PhysicalBuffer()
 {
-	int ret = munmap(static_cast<void*>(m_buffer), pages * page_size_bt);
+	int ret = munmap(static_cast<void*>(m_buffer), m_pages * page_size_bt);
 	if (ret < 0) {
 		std::cerr << "Aborting because munmap failed: " << std::strerror(errno);
 		// Abort because munmap() should never fail and if it does future mmap()
@@ -79,9 +171,12 @@ PhysicalBuffer::~PhysicalBuffer()
 	}
 }
 
-RMA2_NLA PhysicalBuffer::response_address() const
+RMA2_NLA PhysicalBuffer::response_address(size_t slot) const
 {
-	return m_physical_address;
+	if (slot >= response_slots) {
+		throw std::out_of_range("Response slot out of range.");
+	}
+	return m_physical_address + slot * quad_word_size_bt;
 }
 
 RMA2_NLA PhysicalBuffer::send_address() const
@@ -91,53 +186,183 @@ RMA2_NLA PhysicalBuffer::send_address() const
 
 size_t PhysicalBuffer::send_buffer_size_qw() const
 {
-	return page_size_qw * (pages - 1);
+	return page_size_qw * (m_pages - 1);
 }
 
-uint64_t PhysicalBuffer::read_response() const
+uint64_t PhysicalBuffer::read_response(size_t slot) const
 {
-	return (*m_buffer)[0];
+	if (slot >= response_slots) {
+		throw std::out_of_range("Response slot out of range.");
+	}
+	return m_buffer[slot];
 }
 
 uint64_t PhysicalBuffer::read_send(size_t index) const
 {
-	return (*m_buffer)[index + page_size_qw];
+	return m_buffer[index + page_size_qw];
 }
 
 void PhysicalBuffer::write_send(size_t index, uint64_t data)
 {
-	(*m_buffer)[index + page_size_qw] = data;
+	m_buffer[index + page_size_qw] = data;
 }
 
-RingBuffer::RingBuffer(RMA2_Port port, RMA2_Handle handle, NotificationPoller& p, size_t pages) :
+RingBuffer::RingBuffer(
+    RMA2_Port port,
+    RMA2_Handle handle,
+    NotificationPoller& p,
+    size_t pages,
+    Layout layout,
+    Allocation allocation) :
     size_bt(pages * page_size_bt),
     size_qw(size_bt / sizeof(uint64_t)),
     m_port(port),
     m_handle(handle),
-    m_poller(p)
+    m_poller(p),
+    m_layout(layout),
+    m_allocation(allocation)
 {
 	if (sysconf(_SC_PAGESIZE) != page_size_bt) {
 		throw std::runtime_error("System page size not 4096!");
 	}
 
-	m_address = std::aligned_alloc(page_size_bt, size_bt);
-	m_buffer = static_cast<uint64_t*>(m_address);
+	// Huge pages are only used if they cover the whole buffer and the driver accepts
+	// their registration, otherwise the buffer falls back to regular pages.
+	m_huge_pages = m_allocation == Allocation::huge_pages && size_bt % huge_page_size_bt == 0 &&
+	               allocate(true);
+	if (m_huge_pages && rma2_register(m_port, m_address, size_bt, &m_region) != RMA2_SUCCESS) {
+		deallocate();
+		m_huge_pages = false;
+	}
 
-	RMA2_ERROR status = rma2_register(m_port, m_address, size_bt, &m_region);
-	throw_on_error<FailedToRegisterRegion>(status);
+	if (!m_huge_pages) {
+		allocate(false);
+		// For a mirrored layout only the first mapping is registered, the Fpga never
+		// writes beyond the end of the buffer.
+		RMA2_ERROR status = rma2_register(m_port, m_address, size_bt, &m_region);
+		if (status != RMA2_SUCCESS) {
+			deallocate();
+		}
+		throw_on_error<FailedToRegisterRegion>(status);
+	}
+	m_buffer = static_cast<uint64_t*>(m_address);
 }
 
 RingBuffer::~RingBuffer()
 {
-	while (poll())
-		;
-
-	m_read_index += m_readable_words;
-	m_readable_words = 0;
-	notify();
+	// Errors reported by the poller must not escape the destructor
+	try {
+		while (poll(std::chrono::milliseconds(20)))
+			;
+		release(m_readable_words);
+	} catch (std::exception const& e) {
+		std::cerr << "Draining ring buffer failed: " << e.what() << "\n";
+	}
 
 	rma2_unregister(m_port, m_region);
-	std::free(m_address);
+	deallocate();
+}
+
+bool RingBuffer::allocate(bool huge_pages)
+{
+	bool const pinned = m_allocation != Allocation::standard;
+	if (m_layout == Layout::linear && !pinned) {
+		m_address = std::aligned_alloc(page_size_bt, size_bt);
+		if (m_address == nullptr) {
+			throw std::bad_alloc();
+		}
+		return true;
+	}
+
+	// Running out of huge pages is not an error, the caller falls back to regular pages
+	auto const fail = [huge_pages](char const* action, char const* message) {
+		if (huge_pages) {
+			return false;
+		}
+		std::cerr << action << " failed: " << std::strerror(errno);
+		throw std::runtime_error(message);
+	};
+	int const populate = pinned ? MAP_POPULATE : 0;
+
+	if (m_layout == Layout::linear) {
+		int const huge_page_flags = huge_pages ? MAP_HUGETLB | MAP_HUGE_2MB : 0;
+		void* address = mmap(
+		    nullptr, size_bt, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | populate | huge_page_flags, -1, 0);
+		if (address == MAP_FAILED) {
+			return fail("Mapping ring buffer", "Failed to map ring buffer.");
+		}
+		m_address = address;
+	} else {
+		unsigned int const huge_page_flags = huge_pages ? MFD_HUGETLB | MFD_HUGE_2MB : 0;
+		m_memory_fd = memfd_create("nhtl-extoll-ring-buffer", MFD_CLOEXEC | huge_page_flags);
+		if (m_memory_fd < 0) {
+			return fail(
+			    "Creating ring buffer memory file", "Failed to create ring buffer memory file.");
+		}
+		if (ftruncate(m_memory_fd, size_bt) < 0) {
+			close(m_memory_fd);
+			return fail(
+			    "Resizing ring buffer memory file", "Failed to resize ring buffer memory file.");
+		}
+
+		// Reserve twice the buffer size aligned to the page size in use and map the
+		// memory file into both halves
+		size_t const alignment = huge_pages ? huge_page_size_bt : page_size_bt;
+		size_t const reserved_bt = 2 * size_bt + alignment;
+		char* reserved = static_cast<char*>(mmap(
+		    nullptr, reserved_bt, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+		if (reserved == MAP_FAILED) {
+			close(m_memory_fd);
+			return fail("Reserving mirrored ring buffer", "Failed to reserve mirrored ring buffer.");
+		}
+		char* base =
+		    reserved + (alignment - reinterpret_cast<uintptr_t>(reserved) % alignment) % alignment;
+		if (base != reserved) {
+			munmap(reserved, base - reserved);
+		}
+		if (base + 2 * size_bt != reserved + reserved_bt) {
+			munmap(base + 2 * size_bt, reserved + reserved_bt - (base + 2 * size_bt));
+		}
+
+		for (size_t offset : {size_t(0), size_bt}) {
+			void* mirror = mmap(
+			    base + offset, size_bt, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED | populate,
+			    m_memory_fd, 0);
+			if (mirror == MAP_FAILED) {
+				munmap(base, 2 * size_bt);
+				close(m_memory_fd);
+				return fail("Mirroring ring buffer", "Failed to map mirrored ring buffer.");
+			}
+		}
+		m_address = base;
+	}
+
+	size_t const mapped_bt = m_layout == Layout::mirrored ? 2 * size_bt : size_bt;
+	if (pinned && mlock(m_address, mapped_bt) < 0) {
+		std::cerr << "Locking ring buffer memory failed: " << std::strerror(errno);
+		deallocate();
+		throw std::runtime_error("Failed to lock ring buffer memory.");
+	}
+	return true;
+}
+
+void RingBuffer::deallocate()
+{
+	if (m_layout == Layout::linear && m_allocation == Allocation::standard) {
+		std::free(m_address);
+		return;
+	}
+
+	size_t const mapped_bt = m_layout == Layout::mirrored ? 2 * size_bt : size_bt;
+	if (munmap(m_address, mapped_bt) < 0) {
+		std::cerr << "Aborting because munmap failed: " << std::strerror(errno);
+		abort();
+	}
+	if (m_memory_fd >= 0) {
+		close(m_memory_fd);
+		m_memory_fd = -1;
+	}
 }
 
 RMA2_Region* RingBuffer::region() const
@@ -162,43 +387,190 @@ RMA2_NLA RingBuffer::address(size_t offset) const
 	return nla;
 }
 
-std::vector<uint64_t> RingBuffer::receive()
+RingBuffer::Layout RingBuffer::layout() const
 {
-	poll();
+	return m_layout;
+}
 
+RingBuffer::Allocation RingBuffer::allocation() const
+{
+	return m_allocation;
+}
+
+bool RingBuffer::huge_pages() const
+{
+	return m_huge_pages;
+}
+
+std::vector<uint64_t> RingBuffer::receive()
+{
 	std::vector<uint64_t> words;
-	words.reserve(m_readable_words);
+	receive_append(words);
+	return words;
+}
 
-	while (m_readable_words > 0) {
-		words.push_back(m_buffer[m_read_index++]);
-		m_read_index %= size_qw;
-		++m_read_words;
-		--m_readable_words;
+size_t RingBuffer::receive_into(std::span<uint64_t> destination)
+{
+	View const view = front(receive_view(), destination.size());
+	copy_view(destination.data(), view);
 
-		if (m_read_words > num_words_to_notify) {
-			notify();
-		}
+	release(view);
+	return view.size();
+}
+
+std::vector<uint64_t> RingBuffer::receive(
+    size_t min_words, size_t max_words, std::chrono::steady_clock::time_point deadline)
+{
+	if (min_words > max_words) {
+		throw std::invalid_argument("Minimum batch size must not exceed the maximum.");
 	}
+	poll_until(min_words, deadline);
+	View const view = front(readable_view(), max_words);
 
-	notify();
+	std::vector<uint64_t> words(view.size());
+	copy_view(words.data(), view);
 
+	release(view);
 	return words;
 }
 
+size_t RingBuffer::receive_into(
+    std::span<uint64_t> destination,
+    size_t min_words,
+    std::chrono::steady_clock::time_point deadline)
+{
+	if (min_words > destination.size()) {
+		throw std::invalid_argument("Minimum batch size must not exceed the destination.");
+	}
+	poll_until(min_words, deadline);
+	View const view = front(readable_view(), destination.size());
+	copy_view(destination.data(), view);
+
+	release(view);
+	return view.size();
+}
+
+std::vector<uint64_t> RingBuffer::try_receive()
+{
+	poll(std::chrono::milliseconds(0));
+	View const view = readable_view();
+
+	std::vector<uint64_t> words(view.size());
+	copy_view(words.data(), view);
+
+	release(view);
+	return words;
+}
+
+RingBuffer::BatchAwaiter::BatchAwaiter(
+    RingBuffer& ring, size_t min_words, std::chrono::steady_clock::time_point deadline) :
+    NotificationAwaiter(ring.m_poller, deadline), m_ring(ring), m_min_words(min_words)
+{}
+
+bool RingBuffer::BatchAwaiter::try_complete()
+{
+	// The ring buffer is not read while its reader is suspended
+	return m_ring.m_readable_words + pending_packets() >= m_min_words;
+}
+
+std::vector<uint64_t> RingBuffer::BatchAwaiter::await_resume()
+{
+	return m_ring.try_receive();
+}
+
+RingBuffer::BatchAwaiter RingBuffer::next_batch(
+    size_t min_words, std::chrono::steady_clock::time_point deadline)
+{
+	return BatchAwaiter(*this, min_words, deadline);
+}
+
+size_t RingBuffer::receive_append(std::vector<uint64_t>& destination)
+{
+	View const view = receive_view();
+
+	size_t const offset = destination.size();
+	destination.resize(offset + view.size());
+	copy_view(destination.data() + offset, view);
+
+	release(view);
+	return view.size();
+}
+
+RingBuffer::View RingBuffer::receive_view()
+{
+	poll(std::chrono::milliseconds(20));
+	return readable_view();
+}
+
+RingBuffer::View RingBuffer::readable_view() const
+{
+	// Words written by the Fpga must not be read before the notification announcing them
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	if (m_layout == Layout::mirrored) {
+		return {{m_buffer + m_read_index, m_readable_words}, {}};
+	}
+
+	size_t const first_words = std::min(m_readable_words, size_qw - m_read_index);
+	return {
+	    {m_buffer + m_read_index, first_words}, {m_buffer, m_readable_words - first_words}};
+}
+
+void RingBuffer::release(size_t words)
+{
+	if (words > m_readable_words) {
+		throw std::out_of_range("Cannot release more words than are readable.");
+	}
+	if (words == 0) {
+		return;
+	}
+
+	m_read_index = (m_read_index + words) % size_qw;
+	m_readable_words -= words;
+	m_read_words += words;
+	notify();
+}
+
+void RingBuffer::release(View const& view)
+{
+	release(view.size());
+}
+
 void RingBuffer::notify()
 {
-	uint64_t payload = (trace_identifier << 48u) | m_read_words;
-	rma2_post_notification(m_port, m_handle, 0, payload, RMA2_NO_NOTIFICATION, RMA2_CMD_DEFAULT);
-	m_read_words = 0;
+	// The Fpga accepts at most num_words_to_notify credits per notification
+	do {
+		size_t const words = std::min(m_read_words, num_words_to_notify);
+		uint64_t payload = (trace_identifier << 48u) | words;
+		rma2_post_notification(
+		    m_port, m_handle, 0, payload, RMA2_NO_NOTIFICATION, RMA2_CMD_DEFAULT);
+		m_read_words -= words;
+	} while (m_read_words > 0);
 }
 
-bool RingBuffer::poll()
+bool RingBuffer::poll(std::chrono::nanoseconds timeout)
 {
-	uint64_t packets = m_poller.consume_packets(std::chrono::milliseconds(20));
+	uint64_t packets = m_poller.consume_packets(timeout);
 	m_readable_words += packets;
 	return packets != 0;
 }
 
+bool RingBuffer::poll_until(size_t min_words, std::chrono::steady_clock::time_point deadline)
+{
+	// The Fpga never writes more words than the buffer holds without being credited
+	min_words = std::min(min_words, size_qw);
+
+	poll(std::chrono::nanoseconds(0));
+	while (m_readable_words < min_words) {
+		auto const now = std::chrono::steady_clock::now();
+		if (now >= deadline) {
+			return false;
+		}
+		poll(deadline - now);
+	}
+	return true;
+}
+
 void RingBuffer::reset()
 {
 	m_read_index = 0;
@@ -0,0 +1,96 @@
+#include "nhtl-extoll/completion_tickets.h"
+
+#include <algorithm>
+
+namespace nhtl_extoll {
+
+namespace {
+
+int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+	           std::chrono::steady_clock::now().time_since_epoch())
+	    .count();
+}
+
+} // namespace
+
+CompletionTickets::CompletionTickets(std::chrono::nanoseconds lost_after) :
+    m_lost_after(lost_after)
+{}
+
+std::unique_lock<std::mutex> CompletionTickets::lock_posting()
+{
+	return std::unique_lock<std::mutex>(m_post_mutex);
+}
+
+uint64_t CompletionTickets::issue(std::unique_lock<std::mutex> const&, size_t count)
+{
+	int64_t const posted_at = now_ns();
+	uint64_t const first = m_posted;
+	m_posted += count;
+	for (uint64_t ticket = m_posted - std::min(count, history); ticket < m_posted; ++ticket) {
+		m_posted_at[ticket % history].store(posted_at, std::memory_order_relaxed);
+	}
+	return first;
+}
+
+void CompletionTickets::complete(bool stamp)
+{
+	// Published before the count, so a waiter seeing the stamp of a later access with the
+	// same index also sees that its own one was overwritten
+	m_completed_at[m_completions.value() % history].store(
+	    stamp ? now_ns() : 0, std::memory_order_release);
+	m_completions.add(1);
+}
+
+uint64_t CompletionTickets::completions() const
+{
+	return m_completions.value();
+}
+
+bool CompletionTickets::completed(uint64_t ticket) const
+{
+	return completions() > ticket;
+}
+
+bool CompletionTickets::wait_for(uint64_t ticket, std::chrono::nanoseconds timeout)
+{
+	return m_completions.wait_until(ticket + 1, timeout);
+}
+
+void CompletionTickets::abandon(uint64_t ticket)
+{
+	std::lock_guard<std::mutex> lock{m_post_mutex};
+	// The post time of a ticket older than the history has been overwritten, but such
+	// an access is overdue anyway
+	bool const recent = m_posted - ticket <= history;
+	int64_t const age_ns =
+	    recent ? now_ns() - m_posted_at[ticket % history].load(std::memory_order_relaxed) : 0;
+	if (!recent || age_ns >= m_lost_after.count()) {
+		// Lost completions have no time of their own
+		uint64_t const oldest = ticket + 1 > history ? ticket + 1 - history : 0;
+		for (uint64_t lost = std::max(m_completions.value(), oldest); lost <= ticket; ++lost) {
+			m_completed_at[lost % history].store(0, std::memory_order_relaxed);
+		}
+		m_completions.raise_to(ticket + 1);
+	}
+}
+
+std::optional<std::chrono::steady_clock::time_point> CompletionTickets::completed_at(
+    uint64_t ticket) const
+{
+	int64_t const stamp_ns = m_completed_at[ticket % history].load(std::memory_order_acquire);
+	uint64_t const count = completions();
+	if (stamp_ns == 0 || count <= ticket || count - ticket >= history) {
+		return std::nullopt;
+	}
+	return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(stamp_ns));
+}
+
+NotificationCounter const& CompletionTickets::counter() const
+{
+	return m_completions;
+}
+
+} // namespace nhtl_extoll
@@ -1,43 +1,74 @@
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
 #include "nhtl-extoll/configure_fpga.h"
+#include "nhtl-extoll/rra_batch.h"
 
 namespace nhtl_extoll {
 
+namespace {
+
+/// Derives the default configuration of a ring buffer on the Fpga from its host-side size
+PartnerHostConfiguration::Ringbuffer default_ring_buffer_configuration(RingBuffer const& ring)
+{
+	if (ring.size_bt > std::numeric_limits<uint32_t>::max()) {
+		throw std::invalid_argument("Ring buffer capacity exceeds the Fpga's 32 bit size field.");
+	}
+	return {
+	    ring.address(0),
+	    static_cast<uint32_t>(ring.size_bt),
+	    0x7c0,
+	    false,
+	    0x100,
+	    static_cast<uint32_t>(ring.size_qw / 62 - 8)};
+}
+
+} // namespace
+
 void configure_fpga(Endpoint& connection, PartnerHostConfiguration config)
 {
-	connection.rra_write<HostEndpoint>(
+	// The writes are pipelined and only waited for where the order with respect to the
+	// host matters
+	RraBatch batch(connection);
+	batch.write<HostEndpoint>(
 	    {config.local_node, config.protection_domain_id, config.vpid, config.mode});
-	connection.rra_write<ConfigResponse>({config.config_put_address});
-
-	connection.rra_write<HicannBufferStart>({config.hicann.start_address});
-	connection.rra_write<HicannBufferSize>({config.hicann.capacity});
-	connection.rra_write<HicannBufferFullThreshold>({config.hicann.threshold});
-	connection.rra_write<HicannNotificationBehaviour>(
-	    {config.hicann.timeout, config.hicann.frequency});
-	if (config.hicann.reset_counter) {
-		connection.rra_write<HicannBufferCounterReset>({true});
+	batch.write<ConfigResponse>({config.config_put_address});
+
+	if (config.hicann_enabled) {
+		batch.write<HicannBufferStart>({config.hicann.start_address});
+		batch.write<HicannBufferSize>({config.hicann.capacity});
+		batch.write<HicannBufferFullThreshold>({config.hicann.threshold});
+		batch.write<HicannNotificationBehaviour>({config.hicann.timeout, config.hicann.frequency});
+		if (config.hicann.reset_counter) {
+			batch.write<HicannBufferCounterReset>({true});
+		}
 	}
 
 	// Start of trace buffer configuration
 	// Remove when trace ring buffer is removed from FPGA
-	connection.rra_write<TraceBufferStart>({config.trace.start_address});
-	connection.rra_write<TraceBufferSize>({config.trace.capacity});
-	connection.rra_write<TraceBufferFullThreshold>({config.trace.threshold});
-	connection.rra_write<TraceNotificationBehaviour>(
-	    {config.trace.timeout, config.trace.frequency});
+	batch.write<TraceBufferStart>({config.trace.start_address});
+	batch.write<TraceBufferSize>({config.trace.capacity});
+	batch.write<TraceBufferFullThreshold>({config.trace.threshold});
+	batch.write<TraceNotificationBehaviour>({config.trace.timeout, config.trace.frequency});
 	if (config.trace.reset_counter) {
-		connection.rra_write<TraceBufferCounterReset>({true});
+		batch.write<TraceBufferCounterReset>({true});
 	}
 
-	connection.rra_write<TraceBufferInit>({true});
+	batch.write<TraceBufferInit>({true});
 	// End of trace buffer configuration
 
-	connection.rra_write<HicannBufferInit>({true});
-	connection.hicann_ring_buffer.reset();
+	if (config.hicann_enabled) {
+		batch.write<HicannBufferInit>({true});
+	}
+	batch.flush();
+	if (connection.hicann_ring_buffer) {
+		connection.hicann_ring_buffer->reset();
+	}
 	connection.trace_ring_buffer.reset();
 
-	connection.rra_write<HicannTracePktClosure>({config.hicann_trace_pkt_closure});
+	batch.write<HicannTracePktClosure>({config.hicann_trace_pkt_closure});
+	batch.flush();
 
 	Info info = connection.rra_read<Info>();
 	info.ndid(uint16_t(connection.get_node()));
@@ -46,20 +77,19 @@ void configure_fpga(Endpoint& connection, PartnerHostConfiguration config)
 
 void configure_fpga(Endpoint& connection)
 {
-	const auto& hicann_ring_buffer = connection.hicann_ring_buffer;
-	const auto& trace_ring_buffer = connection.trace_ring_buffer;
-
 	PartnerHostConfiguration config{
 	    rma2_get_nodeid(connection.get_rma_port()),
 	    0,
 	    connection.get_rma_vpid(),
 	    0b100,
 	    connection.buffer.response_address(),
-	    {hicann_ring_buffer.address(0), static_cast<uint32_t>(hicann_ring_buffer.size_bt), 0x7c0,
-	     false, 0x100, static_cast<uint32_t>(hicann_ring_buffer.size_qw / 62 - 8)},
-	    {trace_ring_buffer.address(0), static_cast<uint32_t>(trace_ring_buffer.size_bt), 0x7c0,
-	     false, 0x100, static_cast<uint32_t>(trace_ring_buffer.size_qw / 62 - 8)},
-	    512};
+	    {},
+	    default_ring_buffer_configuration(connection.trace_ring_buffer),
+	    512,
+	    connection.options().hicann_ring};
+	if (connection.hicann_ring_buffer) {
+		config.hicann = default_ring_buffer_configuration(*connection.hicann_ring_buffer);
+	}
 
 	configure_fpga(connection, config);
 }
@@ -3,9 +3,12 @@
 #include "rma2_ioctl.h"
 #include "sys/ioctl.h"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 
 #include "nhtl-extoll/exception.h"
 #include "nhtl-extoll/throw_on_error.h"
@@ -73,15 +76,42 @@ RMA2_VPID Connection::get_vpid() const
 }
 
 
-Endpoint::Endpoint(RMA2_Nodeid n) :
+Endpoint::Endpoint(RMA2_Nodeid n, EndpointOptions options) :
     m_node(n),
     m_rra(n, true),
     m_rma(n, false),
-    poller(get_rma_port()),
-    buffer(),
-    hicann_ring_buffer(get_rma_port(), get_rma_handle(), poller, 1),
-    trace_ring_buffer(get_rma_port(), get_rma_handle(), poller, 2048)
+    m_options(options),
+    m_rra_tickets(rra_timeout),
+    m_response_slots(&m_rra_tickets.counter()),
+    buffer(options.send_buffer_pages),
+    poller(
+        options.poller_group
+            ? NotificationPoller(get_rma_port(), *options.poller_group)
+            : NotificationPoller(get_rma_port(), options.polling_policy, options.poller_placement)),
+    rra_poller(
+        options.poller_group ? NotificationPoller(get_rra_port(), *options.poller_group)
+                             : NotificationPoller(
+                                   get_rra_port(), options.rra_polling_policy,
+                                   options.poller_placement)),
+    hicann_ring_buffer(),
+    trace_ring_buffer(
+        get_rma_port(),
+        get_rma_handle(),
+        poller,
+        options.trace_ring_pages,
+        options.trace_ring_layout,
+        options.trace_ring_allocation)
 {
+	// Responses are counted, not consumed, so that every caller can wait for its own
+	rra_poller.set_handler(
+	    NotificationPoller::response_class,
+	    [this](uint64_t) { m_rra_tickets.complete(rra_poller.latency_measurement()); });
+
+	if (options.hicann_ring) {
+		hicann_ring_buffer.emplace(
+		    get_rma_port(), get_rma_handle(), poller, options.hicann_ring_pages);
+	}
+
 	if (!ping()) {
 		std::cerr << "FPGA with Node ID " << n << " did not respond!\n";
 		throw std::runtime_error("Connection Failed: No FPGA response!\n");
@@ -123,65 +153,319 @@ RMA2_VPID Endpoint::get_rma_vpid() const
 	return m_rma.get_vpid();
 }
 
+EndpointOptions const& Endpoint::options() const
+{
+	return m_options;
+}
+
 bool Endpoint::ping() const
 {
-	using namespace std::literals::chrono_literals;
-	bool ping_successful = false;
+	auto const start = std::chrono::steady_clock::now();
+	try {
+		read_register(0x8000, ping_timeout);
+	} catch (FailedToRead const&) {
+		return false;
+	}
+	std::cout << "FPGA with Node ID " << get_node() << " responded after "
+	          << std::chrono::duration_cast<std::chrono::microseconds>(
+	                 std::chrono::steady_clock::now() - start)
+	                 .count()
+	          << "us." << std::endl;
+	return true;
+}
 
+uint64_t Endpoint::post_read(RMA2_NLA address, size_t slot) const
+{
+	auto const lock = m_rra_tickets.lock_posting();
 	RMA2_ERROR status = rma2_post_get_qw_direct(
-	    get_rra_port(), get_rra_handle(), buffer.response_address(), 8, 0x8000,
+	    get_rra_port(), get_rra_handle(), buffer.response_address(slot), 8, address,
 	    RMA2_COMPLETER_NOTIFICATION, RMA2_CMD_DEFAULT);
+	throw_on_error<FailedToRead>(status, get_node(), address);
+	return m_rra_tickets.issue(lock);
+}
 
-	RMA2_Notification* notification;
-	auto wait_period = 10us;
-	auto integral_wait = 0us;
-	for (size_t i = 0; i < 20; i++) {
-		status = rma2_noti_probe(get_rra_port(), &notification);
-		if (status == RMA2_NO_NOTI) {
-			std::this_thread::sleep_for(wait_period);
-			integral_wait += wait_period;
-			wait_period *= 2;
-			continue;
-		} else {
-			rma2_noti_free(get_rra_port(), notification);
-			ping_successful = true;
-			std::cout << "FPGA with Node ID " << get_node() << " responded after "
-			          << integral_wait.count() << "us." << std::endl;
-			break;
-		}
+uint64_t Endpoint::post_write(RMA2_NLA address, uint64_t value)
+{
+	auto const lock = m_rra_tickets.lock_posting();
+	RMA2_ERROR status = rma2_post_immediate_put(
+	    get_rra_port(), get_rra_handle(), 8, value, address, RMA2_COMPLETER_NOTIFICATION,
+	    RMA2_CMD_DEFAULT);
+	throw_on_error<FailedToWrite>(status, get_node(), address);
+	return m_rra_tickets.issue(lock);
+}
+
+bool Endpoint::completed(uint64_t ticket) const
+{
+	return m_rra_tickets.completed(ticket);
+}
+
+bool Endpoint::wait_for(uint64_t ticket, std::chrono::nanoseconds timeout) const
+{
+	bool const done = m_rra_tickets.wait_for(ticket, timeout);
+	if (!done) {
+		m_rra_tickets.abandon(ticket);
+	} else if (auto const completed_at = m_rra_tickets.completed_at(ticket)) {
+		rra_poller.record_response_latency(std::chrono::steady_clock::now() - *completed_at);
+	}
+	rra_poller.rethrow_error();
+	return done;
+}
+
+size_t Endpoint::acquire_slots(std::span<size_t> slots, RMA2_NLA address) const
+{
+	size_t const acquired =
+	    m_response_slots.acquire(slots, std::chrono::steady_clock::now() + rra_timeout);
+	if (acquired == 0) {
+		throw FailedToRead(get_node(), address);
 	}
-	return ping_successful;
+	return acquired;
+}
+
+uint64_t Endpoint::read_register(RMA2_NLA address, std::chrono::nanoseconds timeout) const
+{
+	size_t slot;
+	acquire_slots({&slot, 1}, address);
+	uint64_t ticket;
+	try {
+		ticket = post_read(address, slot);
+	} catch (...) {
+		m_response_slots.release(slot);
+		throw;
+	}
+
+	// The slot of a read without response is only reused once the response arrived,
+	// the Fpga may still write it
+	bool done;
+	try {
+		done = wait_for(ticket, timeout);
+	} catch (...) {
+		m_response_slots.release_after(slot, ticket);
+		throw;
+	}
+	if (!done) {
+		m_response_slots.release_after(slot, ticket);
+		throw FailedToRead(get_node(), address);
+	}
+	uint64_t const value = buffer.read_response(slot);
+	m_response_slots.release(slot);
+	return value;
 }
 
 uint64_t Endpoint::rra_read(RMA2_NLA address) const
 {
-	RMA2_ERROR status = rma2_post_get_qw_direct(
-	    get_rra_port(), get_rra_handle(), buffer.response_address(), 8, address,
-	    RMA2_COMPLETER_NOTIFICATION, RMA2_CMD_DEFAULT);
+	return read_register(address, rra_timeout);
+}
 
-	throw_on_error<FailedToRead>(status, get_node(), address);
+std::vector<uint64_t> Endpoint::rra_read(std::span<RMA2_NLA const> addresses) const
+{
+	std::vector<uint64_t> values;
+	values.reserve(addresses.size());
+	std::vector<size_t> slots(std::min(addresses.size(), ResponseSlots::size));
+
+	while (!addresses.empty()) {
+		size_t const acquired = acquire_slots(
+		    std::span(slots).first(std::min(addresses.size(), slots.size())), addresses.front());
+		auto const chunk = addresses.first(acquired);
+		addresses = addresses.subspan(acquired);
+
+		size_t posted = 0;
+		uint64_t first_ticket;
+		{
+			auto const lock = m_rra_tickets.lock_posting();
+			for (; posted < chunk.size(); ++posted) {
+				RMA2_ERROR status = rma2_post_get_qw_direct(
+				    get_rra_port(), get_rra_handle(), buffer.response_address(slots[posted]), 8,
+				    chunk[posted], RMA2_COMPLETER_NOTIFICATION, RMA2_CMD_DEFAULT);
+				if (status != RMA2_SUCCESS) {
+					break;
+				}
+			}
+			first_ticket = m_rra_tickets.issue(lock, posted);
+		}
 
-	RMA2_Notification* notification;
-	status = rma2_noti_get_block(get_rra_port(), &notification);
-	throw_on_error<FailedToRead>(status, get_node(), address);
-	status = rma2_noti_free(get_rra_port(), notification);
-	throw_on_error<FailedToRead>(status, get_node(), address);
+		// Responses arrive in posting order, the first missing one belongs to the
+		// first read that failed
+		size_t completed = posted;
+		try {
+			uint64_t const last_ticket = first_ticket + posted - 1;
+			if (posted > 0 && !m_rra_tickets.wait_for(last_ticket, rra_timeout)) {
+				uint64_t const total = m_rra_tickets.completions();
+				completed =
+				    total > first_ticket ? std::min<uint64_t>(total - first_ticket, posted) : 0;
+				m_rra_tickets.abandon(last_ticket);
+			}
+			rra_poller.rethrow_error();
+			// Like a consuming call, the batch records the latency of its oldest response
+			if (auto const completed_at = m_rra_tickets.completed_at(first_ticket);
+			    completed > 0 && completed_at) {
+				rra_poller.record_response_latency(
+				    std::chrono::steady_clock::now() - *completed_at);
+			}
+		} catch (...) {
+			for (size_t i = 0; i < posted; ++i) {
+				m_response_slots.release_after(slots[i], first_ticket + i);
+			}
+			for (size_t i = posted; i < chunk.size(); ++i) {
+				m_response_slots.release(slots[i]);
+			}
+			throw;
+		}
+		for (size_t i = 0; i < completed; ++i) {
+			values.push_back(buffer.read_response(slots[i]));
+			m_response_slots.release(slots[i]);
+		}
+		// Slots of reads without response return to the pool once their response arrived
+		for (size_t i = completed; i < posted; ++i) {
+			m_response_slots.release_after(slots[i], first_ticket + i);
+		}
+		for (size_t i = posted; i < chunk.size(); ++i) {
+			m_response_slots.release(slots[i]);
+		}
+		if (completed < chunk.size()) {
+			throw FailedToRead(get_node(), chunk[completed]);
+		}
+	}
+	return values;
+}
 
-	return buffer.read_response();
+RegisterSnapshot Endpoint::snapshot_registers(RegisterRange range) const
+{
+	if (range.first > range.last || range.last > max_address || range.first % sizeof(uint64_t) ||
+	    range.last % sizeof(uint64_t)) {
+		throw std::invalid_argument("Register range must be aligned and within max_address.");
+	}
+
+	std::vector<RMA2_NLA> addresses(range.size());
+	for (size_t i = 0; i < addresses.size(); ++i) {
+		addresses[i] = range.first + i * sizeof(uint64_t);
+	}
+	auto const time = std::chrono::system_clock::now();
+	return RegisterSnapshot(range, rra_read(addresses), time);
 }
 
 void Endpoint::rra_write(RMA2_NLA address, uint64_t value)
 {
-	RMA2_ERROR status = rma2_post_immediate_put(
-	    get_rra_port(), get_rra_handle(), 8, value, address, RMA2_COMPLETER_NOTIFICATION,
-	    RMA2_CMD_DEFAULT);
-	throw_on_error<FailedToWrite>(status, get_node(), address);
+	if (!wait_for(post_write(address, value), rra_timeout)) {
+		throw FailedToWrite(get_node(), address);
+	}
+}
 
-	RMA2_Notification* notification;
-	status = rma2_noti_get_block(get_rra_port(), &notification);
-	throw_on_error<FailedToWrite>(status, get_node(), address);
-	status = rma2_noti_free(get_rra_port(), notification);
-	throw_on_error<FailedToWrite>(status, get_node(), address);
+Endpoint::RraCompletion::RraCompletion(
+    Endpoint const& endpoint,
+    RMA2_NLA address,
+    uint64_t ticket,
+    std::chrono::steady_clock::time_point deadline) :
+    NotificationAwaiter(endpoint.rra_poller, deadline),
+    m_endpoint(endpoint),
+    m_address(address),
+    m_ticket(ticket)
+{}
+
+bool Endpoint::RraCompletion::ready() const
+{
+	return m_endpoint.completed(m_ticket);
+}
+
+bool Endpoint::RraCompletion::wait() const
+{
+	auto const remaining = deadline() - std::chrono::steady_clock::now();
+	return m_endpoint.wait_for(m_ticket, std::max(remaining, remaining.zero()));
+}
+
+RMA2_NLA Endpoint::RraCompletion::address() const
+{
+	return m_address;
+}
+
+bool Endpoint::RraCompletion::try_complete()
+{
+	return ready();
+}
+
+Endpoint::ReadCompletion::ReadCompletion(
+    Endpoint const& endpoint,
+    RMA2_NLA address,
+    uint64_t ticket,
+    size_t slot,
+    std::chrono::steady_clock::time_point deadline) :
+    RraCompletion(endpoint, address, ticket, deadline), m_slot(slot)
+{}
+
+Endpoint::ReadCompletion::ReadCompletion(ReadCompletion&& other) :
+    RraCompletion(other),
+    m_slot(std::exchange(other.m_slot, std::nullopt)),
+    m_value(other.m_value)
+{}
+
+Endpoint::ReadCompletion::~ReadCompletion()
+{
+	if (!m_slot) {
+		return;
+	}
+	// The Fpga may still write the slot of a read dropped before its response arrived
+	if (ready()) {
+		m_endpoint.m_response_slots.release(*m_slot);
+	} else {
+		m_endpoint.m_response_slots.release_after(*m_slot, m_ticket);
+	}
+}
+
+uint64_t Endpoint::ReadCompletion::get()
+{
+	if (m_value) {
+		return *m_value;
+	}
+	// The slot of a read without response is kept until the token is destroyed
+	if (!wait()) {
+		throw FailedToRead(m_endpoint.get_node(), m_address);
+	}
+	m_value = m_endpoint.buffer.read_response(*m_slot);
+	m_endpoint.m_response_slots.release(*std::exchange(m_slot, std::nullopt));
+	return *m_value;
+}
+
+uint64_t Endpoint::ReadCompletion::await_resume()
+{
+	return get();
+}
+
+Endpoint::WriteCompletion::WriteCompletion(
+    Endpoint const& endpoint,
+    RMA2_NLA address,
+    uint64_t ticket,
+    std::chrono::steady_clock::time_point deadline) :
+    RraCompletion(endpoint, address, ticket, deadline)
+{}
+
+void Endpoint::WriteCompletion::get()
+{
+	if (!wait()) {
+		throw FailedToWrite(m_endpoint.get_node(), m_address);
+	}
+}
+
+void Endpoint::WriteCompletion::await_resume()
+{
+	get();
+}
+
+Endpoint::ReadCompletion Endpoint::rra_read_async(
+    RMA2_NLA address, std::chrono::steady_clock::time_point deadline) const
+{
+	size_t slot;
+	acquire_slots({&slot, 1}, address);
+	try {
+		return ReadCompletion(*this, address, post_read(address, slot), slot, deadline);
+	} catch (...) {
+		m_response_slots.release(slot);
+		throw;
+	}
+}
+
+Endpoint::WriteCompletion Endpoint::rra_write_async(
+    RMA2_NLA address, uint64_t value, std::chrono::steady_clock::time_point deadline)
+{
+	return WriteCompletion(*this, address, post_write(address, value), deadline);
 }
 
 void Endpoint::rma_send(size_t quad_words)
@@ -1,5 +1,7 @@
 #include "nhtl-extoll/exception.h"
 
+#include <string>
+
 namespace nhtl_extoll {
 
 NodeIsNoFpga::NodeIsNoFpga(RMA2_Nodeid n, uint32_t d) :
@@ -14,6 +16,12 @@ FailedToRead::FailedToRead(RMA2_Nodeid n, RMA2_NLA a) : RraError("Failed to read
 
 FailedToWrite::FailedToWrite(RMA2_Nodeid n, RMA2_NLA a) : RraError("Failed to write!", n, a) {}
 
+UnknownNotificationClass::UnknownNotificationClass(RMA2_Class c, uint64_t p) :
+    RmaError("Received notification of unknown class " + std::to_string(c) + "!"),
+    cls(c),
+    payload(p)
+{}
+
 FailedToRegisterRegion::FailedToRegisterRegion() : RmaError("Failed to register region") {}
 
 } // namespace nhtl_extoll
@@ -0,0 +1,125 @@
+#include "nhtl-extoll/latency_histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace nhtl_extoll {
+
+namespace {
+
+constexpr unsigned sub_bucket_bits = std::countr_zero(LatencyHistogram::sub_buckets);
+static_assert(
+    LatencyHistogram::bucket_count == (64 - sub_bucket_bits + 1) * LatencyHistogram::sub_buckets);
+
+} // namespace
+
+size_t LatencyHistogram::index(uint64_t latency_ns)
+{
+	if (latency_ns < sub_buckets) {
+		return latency_ns;
+	}
+	// The leading bit selects the magnitude, the following bits the linear bucket
+	unsigned const magnitude = std::bit_width(latency_ns) - sub_bucket_bits;
+	return magnitude * sub_buckets + ((latency_ns >> (magnitude - 1)) & (sub_buckets - 1));
+}
+
+uint64_t LatencyHistogram::lower_bound(size_t index)
+{
+	size_t const magnitude = index / sub_buckets;
+	uint64_t const sub_bucket = index % sub_buckets;
+	if (magnitude == 0) {
+		return sub_bucket;
+	}
+	return (sub_buckets + sub_bucket) << (magnitude - 1);
+}
+
+uint64_t LatencyHistogram::upper_bound(size_t index)
+{
+	size_t const magnitude = index / sub_buckets;
+	uint64_t const width = magnitude == 0 ? 1 : uint64_t(1) << (magnitude - 1);
+	return lower_bound(index) + (width - 1);
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency)
+{
+	uint64_t const latency_ns = std::max<int64_t>(latency.count(), 0);
+	m_buckets[index(latency_ns)].fetch_add(1, std::memory_order_relaxed);
+	m_sum_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t max_ns = m_max_ns.load(std::memory_order_relaxed);
+	while (latency_ns > max_ns &&
+	       !m_max_ns.compare_exchange_weak(max_ns, latency_ns, std::memory_order_relaxed))
+		;
+}
+
+uint64_t LatencyHistogram::count() const
+{
+	return m_count.load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds LatencyHistogram::mean() const
+{
+	uint64_t const recorded = count();
+	if (recorded == 0) {
+		return std::chrono::nanoseconds(0);
+	}
+	return std::chrono::nanoseconds(m_sum_ns.load(std::memory_order_relaxed) / recorded);
+}
+
+std::chrono::nanoseconds LatencyHistogram::max() const
+{
+	return std::chrono::nanoseconds(m_max_ns.load(std::memory_order_relaxed));
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double fraction) const
+{
+	// The total is summed from the buckets, it may differ from `m_count` while recording
+	std::array<uint64_t, bucket_count> counts;
+	uint64_t total = 0;
+	for (size_t i = 0; i < bucket_count; ++i) {
+		counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+		total += counts[i];
+	}
+	if (total == 0) {
+		return std::chrono::nanoseconds(0);
+	}
+
+	uint64_t const rank =
+	    std::max<uint64_t>(std::ceil(std::clamp(fraction, 0., 1.) * total), uint64_t(1));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < bucket_count; ++i) {
+		seen += counts[i];
+		if (seen >= rank) {
+			return std::chrono::nanoseconds(std::min(upper_bound(i), uint64_t(max().count())));
+		}
+	}
+	return max();
+}
+
+std::vector<LatencyHistogram::Bucket> LatencyHistogram::buckets() const
+{
+	std::vector<Bucket> result;
+	for (size_t i = 0; i < bucket_count; ++i) {
+		uint64_t const hits = m_buckets[i].load(std::memory_order_relaxed);
+		if (hits != 0) {
+			result.push_back(
+			    {std::chrono::nanoseconds(lower_bound(i)), std::chrono::nanoseconds(upper_bound(i)),
+			     hits});
+		}
+	}
+	return result;
+}
+
+void LatencyHistogram::reset()
+{
+	for (auto& bucket : m_buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	m_count.store(0, std::memory_order_relaxed);
+	m_sum_ns.store(0, std::memory_order_relaxed);
+	m_max_ns.store(0, std::memory_order_relaxed);
+}
+
+} // namespace nhtl_extoll
@@ -0,0 +1,140 @@
+#include "nhtl-extoll/notification_counter.h"
+
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace nhtl_extoll {
+
+namespace {
+
+// std::atomic::wait has no timeout, so the futex is used directly
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+uint32_t* futex_word(std::atomic<uint32_t>& word)
+{
+	return reinterpret_cast<uint32_t*>(&word);
+}
+
+void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout)
+{
+	auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+	timespec const relative{
+	    static_cast<time_t>(seconds.count()), static_cast<long>((timeout - seconds).count())};
+	// Spurious wake-ups, timeouts and changed words are all handled by the caller
+	syscall(SYS_futex, futex_word(word), FUTEX_WAIT_PRIVATE, expected, &relative, nullptr, 0);
+}
+
+void futex_wake_all(std::atomic<uint32_t>& word)
+{
+	syscall(SYS_futex, futex_word(word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace
+
+void NotificationCounter::add(uint64_t value)
+{
+	m_value.fetch_add(value);
+	wake();
+}
+
+void NotificationCounter::raise_to(uint64_t target)
+{
+	uint64_t value = m_value.load();
+	while (value < target && !m_value.compare_exchange_weak(value, target)) {
+	}
+	if (value < target) {
+		wake();
+	}
+}
+
+void NotificationCounter::wake()
+{
+	// Pairs with the waiter registration in `consume()`: either the consumer sees the new
+	// value or the producer sees the waiter
+	if (m_waiters.load() > 0) {
+		m_epoch.fetch_add(1);
+		futex_wake_all(m_epoch);
+	}
+}
+
+uint64_t NotificationCounter::consume_all(std::chrono::nanoseconds timeout)
+{
+	return consume(true, timeout);
+}
+
+bool NotificationCounter::consume_one(std::chrono::nanoseconds timeout)
+{
+	return consume(false, timeout) > 0;
+}
+
+uint64_t NotificationCounter::value() const
+{
+	return m_value.load(std::memory_order_acquire);
+}
+
+bool NotificationCounter::wait_until(uint64_t target, std::chrono::nanoseconds timeout)
+{
+	if (value() >= target || timeout <= timeout.zero()) {
+		return value() >= target;
+	}
+
+	auto const deadline = std::chrono::steady_clock::now() + timeout;
+	while (true) {
+		m_waiters.fetch_add(1);
+		uint32_t const epoch = m_epoch.load();
+		bool const reached = value() >= target;
+		if (!reached) {
+			auto const remaining = deadline - std::chrono::steady_clock::now();
+			if (remaining > remaining.zero()) {
+				futex_wait(m_epoch, epoch, remaining);
+			}
+		}
+		m_waiters.fetch_sub(1);
+
+		if (reached || std::chrono::steady_clock::now() >= deadline) {
+			return reached || value() >= target;
+		}
+	}
+}
+
+uint64_t NotificationCounter::try_consume(bool all)
+{
+	if (all) {
+		return m_value.exchange(0);
+	}
+	uint64_t value = m_value.load();
+	while (value > 0 && !m_value.compare_exchange_weak(value, value - 1)) {
+	}
+	return value > 0 ? 1 : 0;
+}
+
+uint64_t NotificationCounter::consume(bool all, std::chrono::nanoseconds timeout)
+{
+	if (uint64_t const value = try_consume(all); value > 0 || timeout <= timeout.zero()) {
+		return value;
+	}
+
+	auto const deadline = std::chrono::steady_clock::now() + timeout;
+	while (true) {
+		m_waiters.fetch_add(1);
+		uint32_t const epoch = m_epoch.load();
+		uint64_t const value = try_consume(all);
+		if (value == 0) {
+			auto const remaining = deadline - std::chrono::steady_clock::now();
+			if (remaining > remaining.zero()) {
+				futex_wait(m_epoch, epoch, remaining);
+			}
+		}
+		m_waiters.fetch_sub(1);
+
+		if (value > 0 || std::chrono::steady_clock::now() >= deadline) {
+			return value > 0 ? value : try_consume(all);
+		}
+	}
+}
+
+} // namespace nhtl_extoll
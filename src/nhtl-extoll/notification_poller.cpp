@@ -1,88 +1,734 @@
 #include "nhtl-extoll/notification_poller.h"
+#include "nhtl-extoll/exception.h"
+#include "nhtl-extoll/poller_group.h"
+#include "nhtl-extoll/throw_on_error.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace nhtl_extoll {
 
-NotificationPoller::NotificationPoller(RMA2_Port p) :
+namespace {
+
+/// Tells the core that this is a spin-wait loop
+void cpu_relax()
+{
+#if defined(__SSE2__)
+	_mm_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+/// Connects the port to itself so notifications can be posted to it
+RMA2_Handle connect_to_self(RMA2_Port port)
+{
+	RMA2_Handle handle;
+	RMA2_ERROR status = rma2_connect(
+	    port, rma2_get_nodeid(port), rma2_get_vpid(port), RMA2_CONN_DEFAULT, &handle);
+	throw_on_error<ConnectionFailed>(status, "Failed to connect notification poller to itself!");
+	return handle;
+}
+
+/// Reads the CPUs of a NUMA node from sysfs, e.g. "0-7,16-23"
+cpu_set_t numa_node_cpus(int node)
+{
+	std::string const path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+	std::ifstream file(path);
+	std::string list;
+	if (!std::getline(file, list)) {
+		std::cerr << "Reading " << path << " failed.\n";
+		throw std::runtime_error("Failed to read CPUs of NUMA node.");
+	}
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	std::istringstream ranges(list);
+	std::string range;
+	while (std::getline(ranges, range, ',')) {
+		size_t const dash = range.find('-');
+		int const first = std::stoi(range.substr(0, dash));
+		int const last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+		for (int cpu = first; cpu <= last; ++cpu) {
+			CPU_SET(cpu, &cpus);
+		}
+	}
+	return cpus;
+}
+
+/// Sleeps for the period and returns the time actually slept
+std::chrono::nanoseconds sleep(std::chrono::microseconds period)
+{
+	auto const start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(period);
+	return std::chrono::steady_clock::now() - start;
+}
+
+/// Current steady clock time in nanoseconds, never zero
+int64_t probe_time()
+{
+	return std::max<int64_t>(
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(
+	        std::chrono::steady_clock::now().time_since_epoch())
+	        .count(),
+	    1);
+}
+
+} // namespace
+
+NotificationPoller::EventFd::EventFd() : m_fd{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+{
+	if (m_fd < 0) {
+		std::cerr << "Creating poller event file descriptor failed: " << std::strerror(errno);
+		throw std::runtime_error("Failed to create eventfd.");
+	}
+}
+
+NotificationPoller::EventFd::~EventFd()
+{
+	close(m_fd);
+}
+
+int NotificationPoller::EventFd::get() const
+{
+	return m_fd;
+}
+
+void PollerPlacement::apply(std::thread& thread) const
+{
+	if (!cpus.empty() || numa_node) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : cpus) {
+			if (cpu < 0 || cpu >= CPU_SETSIZE) {
+				throw std::invalid_argument("Poller placement contains an invalid CPU.");
+			}
+			CPU_SET(cpu, &set);
+		}
+		if (numa_node) {
+			cpu_set_t const node_cpus = numa_node_cpus(*numa_node);
+			if (cpus.empty()) {
+				set = node_cpus;
+			} else {
+				CPU_AND(&set, &set, &node_cpus);
+			}
+		}
+		if (CPU_COUNT(&set) == 0) {
+			throw std::runtime_error("Poller placement contains no CPU.");
+		}
+		if (int error = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set)) {
+			std::cerr << "Setting poller CPU affinity failed: " << std::strerror(error);
+			throw std::runtime_error("Failed to set poller CPU affinity.");
+		}
+	}
+
+	if (fifo_priority != 0) {
+		sched_param parameters{};
+		parameters.sched_priority = fifo_priority;
+		if (int error = pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &parameters)) {
+			std::cerr << "Setting poller scheduling policy failed: " << std::strerror(error);
+			throw std::runtime_error("Failed to set poller real-time priority.");
+		}
+	}
+
+	if (lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		std::cerr << "Locking process memory failed: " << std::strerror(errno);
+		throw std::runtime_error("Failed to lock process memory.");
+	}
+}
+
+PollingPolicy PollingPolicy::busy_spin()
+{
+	PollingPolicy policy;
+	policy.strategy = Strategy::busy_spin;
+	return policy;
+}
+
+PollingPolicy PollingPolicy::hybrid()
+{
+	PollingPolicy policy;
+	policy.strategy = Strategy::hybrid;
+	return policy;
+}
+
+PollingPolicy PollingPolicy::backoff()
+{
+	return PollingPolicy();
+}
+
+PollingPolicy PollingPolicy::blocking()
+{
+	PollingPolicy policy;
+	policy.strategy = Strategy::blocking;
+	return policy;
+}
+
+PollingPolicy::Idle PollingPolicy::idle(
+    size_t empty_probes, std::chrono::microseconds& sleep_period) const
+{
+	Idle result;
+	switch (strategy) {
+		case Strategy::busy_spin:
+			cpu_relax();
+			break;
+		case Strategy::hybrid:
+			if (empty_probes < spin_probes) {
+				cpu_relax();
+			} else if (empty_probes < spin_probes + yield_probes) {
+				std::this_thread::yield();
+			} else {
+				result.slept = sleep(hybrid_sleep);
+				result.max_backoff = true;
+			}
+			break;
+		case Strategy::backoff:
+		// Blocking waits only return without a notification on errors, which usually
+		// persist, e.g. for an invalid port
+		case Strategy::blocking:
+			result.slept = sleep(sleep_period);
+			result.max_backoff = sleep_period >= max_sleep;
+			sleep_period = std::min(sleep_period * 2, max_sleep);
+			break;
+	}
+	return result;
+}
+
+NotificationPoller::NotificationPoller(
+    RMA2_Port p, PollingPolicy policy, PollerPlacement const& placement) :
     m_port{p},
-    m_running{true},
-    m_thread{&NotificationPoller::poll_notifications, this},
-    m_mutex{},
-    m_cv{}
+    m_policy{policy},
+    m_wake_handle{
+        policy.strategy == PollingPolicy::Strategy::blocking ? connect_to_self(p) : nullptr},
+    m_running{true}
+{
+	replace_handler(
+	    packet_class, std::make_unique<Handler const>(count_payload(m_packets, 0xffffffff)));
+	replace_handler(
+	    response_class, std::make_unique<Handler const>(count_notifications(m_notifications)));
+
+	m_thread = std::thread(&NotificationPoller::poll_notifications, this);
+	pthread_getcpuclockid(m_thread.native_handle(), &m_cpu_clock);
+	try {
+		placement.apply(m_thread);
+	} catch (...) {
+		stop();
+		throw;
+	}
+}
+
+NotificationPoller::NotificationPoller(RMA2_Port p, PollerGroup& group) :
+    m_port{p}, m_policy{group.policy()}, m_group{&group}
 {
-	CPU_SET(sched_getcpu(), &cpu);
-	sched_setaffinity(0, sizeof(cpu_set_t), &cpu);
+	replace_handler(
+	    packet_class, std::make_unique<Handler const>(count_payload(m_packets, 0xffffffff)));
+	replace_handler(
+	    response_class, std::make_unique<Handler const>(count_notifications(m_notifications)));
+
+	group.add(*this);
 }
 
 NotificationPoller::~NotificationPoller()
 {
+	stop();
+}
+
+void NotificationPoller::stop()
+{
+	if (m_group) {
+		auto collected = m_group->remove(*this);
+		resume_awaiters(collected);
+		expire_awaiters();
+		return;
+	}
+
 	m_running.store(false);
+	if (m_wake_handle) {
+		rma2_post_notification(
+		    m_port, m_wake_handle, wake_class, 0, RMA2_NO_NOTIFICATION, RMA2_CMD_DEFAULT);
+	}
 	m_thread.join();
+	if (m_wake_handle) {
+		rma2_disconnect(m_port, m_wake_handle);
+	}
+	expire_awaiters();
 }
 
 void NotificationPoller::poll_notifications()
 {
 	using namespace std::literals::chrono_literals;
 
-	sched_setaffinity(0, sizeof(cpu_set_t), &cpu);
-
-	auto wait_period = 1us;
-	constexpr std::chrono::microseconds max_wait_period = 10ms;
+	size_t empty_probes = 0;
+	auto sleep_period = m_policy.min_sleep;
 
 	while (m_running) {
-		RMA2_Notification* notification;
-		RMA2_ERROR status = rma2_noti_probe(m_port, &notification);
-
-		if (status == RMA2_NO_NOTI) {
-			std::this_thread::sleep_for(wait_period);
-			wait_period = std::min(wait_period * 2, max_wait_period);
-			continue;
-		} else if (status == RMA2_ERR_INV_PORT) {
-			throw std::runtime_error("Invalid port in notification poller");
+		// Suspended awaiters need the thread to wake up at their deadline, so it probes
+		// and backs off instead of blocking while there are any
+		bool const block = m_policy.strategy == PollingPolicy::Strategy::blocking &&
+		                   m_awaiter_count.load(std::memory_order_acquire) == 0;
+		bool const handled = poll_once(block);
+		service_awaiters();
+		if (handled) {
+			empty_probes = 0;
+			sleep_period = m_policy.min_sleep;
+		} else {
+			count_idle(m_policy.idle(empty_probes++, sleep_period));
 		}
-		wait_period = 1us;
-
-		RMA2_Class cls = rma2_noti_get_notiput_class(notification);
-		uint64_t payload = rma2_noti_get_notiput_payload(notification) & 0xffffffff;
-		rma2_noti_free(m_port, notification);
-		{
-			std::lock_guard<std::mutex> lock{m_mutex};
-			switch (cls) {
-				case 0xca:
-					m_packets += payload;
-					break;
-				case 0x0:
-					++m_notifications;
-					break;
-				default:
-					std::cerr << "Unknown notification class: " << uint16_t(cls) << "\n";
-					throw std::runtime_error("Unknown notification class");
-			}
+	}
+}
+
+bool NotificationPoller::poll_once(bool block)
+{
+	RMA2_Notification* notification;
+	RMA2_ERROR status =
+	    block ? rma2_noti_get_block(m_port, &notification) : rma2_noti_probe(m_port, &notification);
+
+	if (status == RMA2_NO_NOTI) {
+		m_empty_probes.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	} else if (status != RMA2_SUCCESS) {
+		fail(std::make_exception_ptr(std::runtime_error(
+		    status == RMA2_ERR_INV_PORT ? "Invalid port in notification poller"
+		                                : "Failed to receive notification")));
+		return false;
+	}
+
+	int64_t const probed = m_measure_latency.load(std::memory_order_relaxed) ? probe_time() : 0;
+	RMA2_Class cls = rma2_noti_get_notiput_class(notification);
+	uint64_t payload = rma2_noti_get_notiput_payload(notification);
+	rma2_noti_free(m_port, notification);
+	if (cls == wake_class) {
+		return true;
+	}
+	m_handled.fetch_add(1, std::memory_order_relaxed);
+	bool const counted =
+	    (cls == packet_class && m_counting_packets.load(std::memory_order_relaxed)) ||
+	    (cls == response_class && m_counting_responses.load(std::memory_order_relaxed));
+	// The probe time is published before the counters, so consumers always find it.
+	// It is only set if no older notification is pending.
+	if (probed != 0 && counted) {
+		int64_t none = 0;
+		(cls == packet_class ? m_packets_pending_since : m_response_pending_since)
+		    .compare_exchange_strong(none, probed);
+	}
+	dispatch(cls, payload);
+	if (counted) {
+		signal_event();
+	}
+	return true;
+}
+
+void NotificationPoller::dispatch(RMA2_Class cls, uint64_t payload)
+{
+	// Sequentially consistent with `replace_handler`: a handler replaced while the
+	// generation was even is never loaded afterwards
+	m_dispatch_generation.fetch_add(1);
+	Handler const* handler = m_handlers[cls].load();
+	try {
+		if (!handler) {
+			throw UnknownNotificationClass(cls, payload);
 		}
-		m_cv.notify_all();
+		(*handler)(payload);
+	} catch (...) {
+		fail(std::current_exception());
+	}
+	m_dispatch_generation.fetch_add(1);
+}
+
+void NotificationPoller::count_idle(PollingPolicy::Idle const& idle)
+{
+	if (idle.slept.count() > 0) {
+		m_sleep_ns.fetch_add(idle.slept.count(), std::memory_order_relaxed);
+	}
+	if (idle.max_backoff) {
+		m_max_backoff_sleeps.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void NotificationPoller::record_latency(
+    std::atomic<int64_t>& pending_since, LatencyHistogram& histogram)
+{
+	if (pending_since.load(std::memory_order_relaxed) == 0) {
+		return;
 	}
+	int64_t const probed = pending_since.exchange(0);
+	if (probed != 0) {
+		histogram.record(std::chrono::nanoseconds(probe_time() - probed));
+	}
+}
+
+void NotificationPoller::set_latency_measurement(bool enabled)
+{
+	m_measure_latency.store(false);
+	m_packets_pending_since.store(0);
+	m_response_pending_since.store(0);
+	if (enabled) {
+		m_packet_latency.reset();
+		m_response_latency.reset();
+		m_measure_latency.store(true);
+	}
+}
+
+LatencyHistogram const& NotificationPoller::packet_latency() const
+{
+	return m_packet_latency;
+}
+
+LatencyHistogram const& NotificationPoller::response_latency() const
+{
+	return m_response_latency;
+}
+
+bool NotificationPoller::latency_measurement() const
+{
+	return m_measure_latency.load(std::memory_order_relaxed);
+}
+
+void NotificationPoller::record_response_latency(std::chrono::nanoseconds latency)
+{
+	if (latency_measurement()) {
+		m_response_latency.record(latency);
+	}
+}
+
+void NotificationPoller::fail(std::exception_ptr error)
+{
+	std::lock_guard<std::mutex> lock{m_error_mutex};
+	if (!m_error) {
+		m_error = error;
+		m_failed.store(true, std::memory_order_release);
+	}
+	signal_event();
+}
+
+void NotificationPoller::signal_event()
+{
+	// Only the first signal after the consumers reset the descriptor needs a system call
+	if (!m_event_signalled.exchange(true)) {
+		uint64_t const value = 1;
+		[[maybe_unused]] auto const written = write(m_event_fd.get(), &value, sizeof(value));
+	}
+}
+
+void NotificationPoller::acknowledge_event()
+{
+	// The descriptor is drained before the flag is cleared. A signal in between finds the
+	// flag still set and skips its write, but the consumer resignals after consuming.
+	// Draining after clearing could swallow the write of such a signal for good.
+	if (m_event_signalled.load()) {
+		uint64_t value;
+		[[maybe_unused]] auto const read_bt = read(m_event_fd.get(), &value, sizeof(value));
+		m_event_signalled.store(false);
+	}
+}
+
+void NotificationPoller::resignal_event()
+{
+	if (m_packets.value() > 0 || m_notifications.value() > 0 ||
+	    m_failed.load(std::memory_order_acquire)) {
+		signal_event();
+	}
+}
+
+void NotificationPoller::service_awaiters()
+{
+	std::vector<NotificationAwaiter*> resumable;
+	collect_awaiters(resumable);
+	resume_awaiters(resumable);
+}
+
+void NotificationPoller::collect_awaiters(std::vector<NotificationAwaiter*>& resumable)
+{
+	if (m_awaiter_count.load(std::memory_order_acquire) == 0) {
+		return;
+	}
+
+	auto const now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock{m_awaiter_mutex};
+	std::erase_if(m_awaiters, [&](NotificationAwaiter* awaiter) {
+		if (awaiter->done()) {
+			resumable.push_back(awaiter);
+			return true;
+		}
+		if (now >= awaiter->m_deadline) {
+			awaiter->m_expired = true;
+			resumable.push_back(awaiter);
+			return true;
+		}
+		return false;
+	});
+	m_awaiter_count.store(m_awaiters.size(), std::memory_order_release);
+}
+
+void NotificationPoller::resume_awaiters(std::vector<NotificationAwaiter*>& resumable)
+{
+	for (NotificationAwaiter* awaiter : resumable) {
+		awaiter->m_handle.resume();
+	}
+	resumable.clear();
+}
+
+void NotificationPoller::expire_awaiters()
+{
+	std::vector<NotificationAwaiter*> resumable;
+	{
+		std::lock_guard<std::mutex> lock{m_awaiter_mutex};
+		resumable.swap(m_awaiters);
+		m_awaiter_count.store(0, std::memory_order_release);
+	}
+	for (NotificationAwaiter* awaiter : resumable) {
+		awaiter->m_expired = true;
+		awaiter->m_handle.resume();
+	}
+}
+
+bool NotificationPoller::suspend(NotificationAwaiter& awaiter)
+{
+	std::lock_guard<std::mutex> lock{m_awaiter_mutex};
+	// Notifications handled before registration would not resume the awaiter
+	if (awaiter.done()) {
+		return false;
+	}
+	m_awaiters.push_back(&awaiter);
+	m_awaiter_count.store(m_awaiters.size(), std::memory_order_release);
+	// The blocked thread has to start probing to notice the deadline
+	if (m_wake_handle && m_awaiters.size() == 1) {
+		rma2_post_notification(
+		    m_port, m_wake_handle, wake_class, 0, RMA2_NO_NOTIFICATION, RMA2_CMD_DEFAULT);
+	}
+	return true;
+}
+
+NotificationAwaiter::NotificationAwaiter(
+    NotificationPoller& poller, std::chrono::steady_clock::time_point deadline) :
+    m_poller(poller), m_deadline(deadline)
+{}
+
+bool NotificationAwaiter::await_ready()
+{
+	return done();
+}
+
+bool NotificationAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	m_handle = handle;
+	return m_poller.suspend(*this);
+}
+
+bool NotificationAwaiter::done()
+{
+	return m_poller.m_failed.load(std::memory_order_acquire) || try_complete();
+}
+
+bool NotificationAwaiter::expired() const
+{
+	return m_expired;
+}
+
+std::chrono::steady_clock::time_point NotificationAwaiter::deadline() const
+{
+	return m_deadline;
+}
+
+bool NotificationAwaiter::take_response()
+{
+	if (!m_poller.m_notifications.consume_one(std::chrono::nanoseconds(0))) {
+		return false;
+	}
+	m_poller.record_latency(m_poller.m_response_pending_since, m_poller.m_response_latency);
+	return true;
+}
+
+uint64_t NotificationAwaiter::pending_packets() const
+{
+	return m_poller.m_packets.value();
+}
+
+bool NotificationPoller::ResponseAwaiter::try_complete()
+{
+	return take_response();
+}
+
+bool NotificationPoller::ResponseAwaiter::await_resume()
+{
+	m_poller.rethrow_error();
+	return !expired();
+}
+
+NotificationPoller::ResponseAwaiter NotificationPoller::next_response(
+    std::chrono::steady_clock::time_point deadline)
+{
+	check_counting(response_class);
+	return ResponseAwaiter(*this, deadline);
+}
+
+int NotificationPoller::event_fd() const
+{
+	return m_event_fd.get();
+}
+
+void NotificationPoller::rethrow_error()
+{
+	if (!m_failed.load(std::memory_order_acquire)) {
+		return;
+	}
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock{m_error_mutex};
+		error = std::exchange(m_error, nullptr);
+		m_failed.store(false, std::memory_order_relaxed);
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+void NotificationPoller::set_handler(RMA2_Class cls, Handler handler)
+{
+	if (cls == wake_class) {
+		throw std::invalid_argument("Notification class is reserved for waking the poller.");
+	}
+	stop_counting(cls);
+	replace_handler(cls, std::make_unique<Handler const>(std::move(handler)));
+}
+
+void NotificationPoller::clear_handler(RMA2_Class cls)
+{
+	stop_counting(cls);
+	replace_handler(cls, nullptr);
+}
+
+void NotificationPoller::stop_counting(RMA2_Class cls)
+{
+	if (cls == packet_class) {
+		m_counting_packets.store(false);
+	} else if (cls == response_class) {
+		m_counting_responses.store(false);
+	}
+}
+
+void NotificationPoller::check_counting(RMA2_Class cls) const
+{
+	if (cls == packet_class && !m_counting_packets.load(std::memory_order_relaxed)) {
+		throw std::logic_error("Ring buffer packets are dispatched to a custom handler.");
+	}
+	if (cls == response_class && !m_counting_responses.load(std::memory_order_relaxed)) {
+		throw std::logic_error("Register responses are dispatched to a custom handler.");
+	}
+}
+
+void NotificationPoller::replace_handler(RMA2_Class cls, std::unique_ptr<Handler const> handler)
+{
+	std::lock_guard<std::mutex> lock{m_handler_mutex};
+	m_handlers[cls].store(handler.get());
+	std::swap(m_handler_storage[cls], handler);
+	uint64_t const generation = m_dispatch_generation.load();
+
+	// Handlers replaced during an earlier dispatch are unused once it finished
+	std::erase_if(m_retired_handlers, [generation](auto const& retired) {
+		return retired.first != generation;
+	});
+	if (handler && generation % 2 == 1) {
+		m_retired_handlers.emplace_back(generation, std::move(handler));
+	}
+}
+
+NotificationPoller::Handler NotificationPoller::count_payload(
+    NotificationCounter& counter, uint64_t mask)
+{
+	return [&counter, mask](uint64_t payload) { counter.add(payload & mask); };
+}
+
+NotificationPoller::Handler NotificationPoller::count_notifications(NotificationCounter& counter)
+{
+	return [&counter](uint64_t) { counter.add(1); };
+}
+
+NotificationPoller::Handler NotificationPoller::enqueue_payload(SpscQueue<uint64_t>& queue)
+{
+	return [&queue](uint64_t payload) {
+		if (!queue.try_push(std::move(payload))) {
+			throw std::runtime_error("Notification queue overflow, payload dropped.");
+		}
+	};
+}
+
+PollingPolicy const& NotificationPoller::policy() const
+{
+	return m_policy;
+}
+
+NotificationPoller::Statistics NotificationPoller::statistics() const
+{
+	timespec cpu_time{};
+	clock_gettime(m_cpu_clock, &cpu_time);
+	return {
+	    m_policy,
+	    m_handled.load(std::memory_order_relaxed),
+	    m_empty_probes.load(std::memory_order_relaxed),
+	    std::chrono::nanoseconds(m_sleep_ns.load(std::memory_order_relaxed)),
+	    m_max_backoff_sleeps.load(std::memory_order_relaxed),
+	    std::chrono::seconds(cpu_time.tv_sec) + std::chrono::nanoseconds(cpu_time.tv_nsec)};
 }
 
 bool NotificationPoller::consume_response(std::chrono::milliseconds timeout)
 {
-	std::unique_lock<std::mutex> lock{m_mutex};
-	m_cv.wait_for(lock, timeout, [this] { return m_notifications > 0; });
-	if (m_notifications > 0) {
-		--m_notifications;
-		return true;
+	check_counting(response_class);
+	acknowledge_event();
+	try {
+		rethrow_error();
+	} catch (...) {
+		resignal_event();
+		throw;
 	}
-	return false;
+	bool const consumed = m_notifications.consume_one(timeout);
+	if (consumed) {
+		record_latency(m_response_pending_since, m_response_latency);
+	}
+	resignal_event();
+	return consumed;
+}
+
+uint64_t NotificationPoller::consume_packets(std::chrono::nanoseconds timeout)
+{
+	check_counting(packet_class);
+	acknowledge_event();
+	try {
+		rethrow_error();
+	} catch (...) {
+		resignal_event();
+		throw;
+	}
+	uint64_t const packets = m_packets.consume_all(timeout);
+	if (packets != 0) {
+		record_latency(m_packets_pending_since, m_packet_latency);
+	}
+	resignal_event();
+	return packets;
+}
+
+bool NotificationPoller::try_consume_response()
+{
+	return consume_response(std::chrono::milliseconds(0));
 }
 
-uint64_t NotificationPoller::consume_packets(std::chrono::milliseconds timeout)
+uint64_t NotificationPoller::try_consume_packets()
 {
-	std::unique_lock<std::mutex> lock{m_mutex};
-	m_cv.wait_for(lock, timeout, [this] { return m_packets > 0; });
-	uint64_t tmp = m_packets;
-	m_packets = 0;
-	return tmp;
+	return consume_packets(std::chrono::nanoseconds(0));
 }
 
 } // namespace nhtl_extoll
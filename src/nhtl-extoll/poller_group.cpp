@@ -0,0 +1,149 @@
+#include "nhtl-extoll/poller_group.h"
+
+#include <pthread.h>
+#include <stdexcept>
+
+namespace nhtl_extoll {
+
+PollerGroup::PollerGroup(size_t threads, PollingPolicy policy, PollerPlacement const& placement) :
+    m_policy{policy}
+{
+	if (threads == 0) {
+		throw std::invalid_argument("Poller group needs at least one thread.");
+	}
+	if (policy.strategy == PollingPolicy::Strategy::blocking) {
+		throw std::invalid_argument("Poller group does not support the blocking strategy.");
+	}
+
+	try {
+		for (size_t i = 0; i < threads; ++i) {
+			auto& worker = *m_workers.emplace_back(std::make_unique<Worker>());
+			worker.thread = std::thread(&PollerGroup::run, this, std::ref(worker));
+			placement.apply(worker.thread);
+		}
+	} catch (...) {
+		stop();
+		throw;
+	}
+}
+
+PollerGroup::~PollerGroup()
+{
+	stop();
+}
+
+void PollerGroup::stop()
+{
+	m_running.store(false);
+	for (auto& worker : m_workers) {
+		if (worker->thread.joinable()) {
+			worker->thread.join();
+		}
+	}
+}
+
+void PollerGroup::run(Worker& worker)
+{
+	size_t empty_sweeps = 0;
+	auto sleep_period = m_policy.min_sleep;
+	PollingPolicy::Idle idle;
+
+	while (m_running) {
+		bool handled = false;
+		{
+			std::lock_guard<std::mutex> lock{worker.mutex};
+			for (NotificationPoller* poller : worker.pollers) {
+				// The idle period after the previous sweep is shared by all ports
+				poller->count_idle(idle);
+				handled |= poller->poll_once(false);
+				poller->collect_awaiters(worker.resumable);
+			}
+		}
+		resume(worker);
+
+		if (handled) {
+			empty_sweeps = 0;
+			sleep_period = m_policy.min_sleep;
+			idle = {};
+		} else {
+			idle = m_policy.idle(empty_sweeps++, sleep_period);
+		}
+	}
+}
+
+void PollerGroup::resume(Worker& worker)
+{
+	// Resumed coroutines may add or remove pollers of the group or block, so they run
+	// without holding the lock. `remove()` waits for the coroutine of its poller instead.
+	std::unique_lock<std::mutex> lock{worker.mutex};
+	while (!worker.resumable.empty()) {
+		NotificationAwaiter* awaiter = worker.resumable.front();
+		worker.resumable.erase(worker.resumable.begin());
+		worker.resuming = &awaiter->m_poller;
+		lock.unlock();
+		awaiter->m_handle.resume();
+		lock.lock();
+		worker.resuming = nullptr;
+		worker.resumed.notify_all();
+	}
+}
+
+void PollerGroup::add(NotificationPoller& poller)
+{
+	Worker* least_busy = nullptr;
+	size_t least_pollers = 0;
+	for (auto& worker : m_workers) {
+		std::lock_guard<std::mutex> lock{worker->mutex};
+		if (!least_busy || worker->pollers.size() < least_pollers) {
+			least_busy = worker.get();
+			least_pollers = worker->pollers.size();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock{least_busy->mutex};
+	least_busy->pollers.push_back(&poller);
+	pthread_getcpuclockid(least_busy->thread.native_handle(), &poller.m_cpu_clock);
+}
+
+std::vector<NotificationAwaiter*> PollerGroup::remove(NotificationPoller& poller)
+{
+	std::vector<NotificationAwaiter*> collected;
+	for (auto& worker : m_workers) {
+		std::unique_lock<std::mutex> lock{worker->mutex};
+		std::erase(worker->pollers, &poller);
+		std::erase_if(worker->resumable, [&](NotificationAwaiter* awaiter) {
+			if (&awaiter->m_poller != &poller) {
+				return false;
+			}
+			collected.push_back(awaiter);
+			return true;
+		});
+		// A coroutine destroying its own poller cannot be waited for
+		if (worker->thread.get_id() != std::this_thread::get_id()) {
+			worker->resumed.wait(lock, [&] { return worker->resuming != &poller; });
+		}
+	}
+	return collected;
+}
+
+PollingPolicy const& PollerGroup::policy() const
+{
+	return m_policy;
+}
+
+size_t PollerGroup::threads() const
+{
+	return m_workers.size();
+}
+
+size_t PollerGroup::size() const
+{
+	size_t pollers = 0;
+	for (auto const& worker : m_workers) {
+		std::lock_guard<std::mutex> lock{worker->mutex};
+		pollers += worker->pollers.size();
+	}
+	return pollers;
+}
+
+} // namespace nhtl_extoll
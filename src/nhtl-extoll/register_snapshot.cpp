@@ -0,0 +1,99 @@
+#include "nhtl-extoll/register_snapshot.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace nhtl_extoll {
+
+namespace {
+
+constexpr RMA2_NLA register_size_bt = sizeof(uint64_t);
+
+} // namespace
+
+size_t RegisterRange::size() const
+{
+	return first > last ? 0 : (last - first) / register_size_bt + 1;
+}
+
+bool RegisterRange::contains(RMA2_NLA address) const
+{
+	return address >= first && address <= last && (address - first) % register_size_bt == 0;
+}
+
+RegisterSnapshot::RegisterSnapshot(
+    RegisterRange range,
+    std::span<uint64_t const> values,
+    std::chrono::system_clock::time_point time) :
+    m_range(range), m_time(time)
+{
+	if (values.size() != range.size()) {
+		throw std::invalid_argument("Number of register values does not match the range.");
+	}
+	for (size_t i = 0; i < values.size(); ++i) {
+		if (values[i] != 0) {
+			m_entries.push_back({range.first + i * register_size_bt, values[i]});
+		}
+	}
+	m_entries.shrink_to_fit();
+}
+
+RegisterRange RegisterSnapshot::range() const
+{
+	return m_range;
+}
+
+std::chrono::system_clock::time_point RegisterSnapshot::time() const
+{
+	return m_time;
+}
+
+std::span<RegisterSnapshot::Entry const> RegisterSnapshot::entries() const
+{
+	return m_entries;
+}
+
+uint64_t RegisterSnapshot::value(RMA2_NLA address) const
+{
+	if (!m_range.contains(address)) {
+		throw std::out_of_range("Register address is not part of the snapshot.");
+	}
+	auto const found = std::lower_bound(
+	    m_entries.begin(), m_entries.end(), address,
+	    [](Entry const& entry, RMA2_NLA wanted) { return entry.address < wanted; });
+	return found != m_entries.end() && found->address == address ? found->value : 0;
+}
+
+std::vector<RegisterSnapshot::Difference> RegisterSnapshot::diff(
+    RegisterSnapshot const& previous) const
+{
+	// Merge the sorted entries of both snapshots, missing entries are zero
+	std::vector<Difference> differences;
+	auto before = previous.m_entries.begin();
+	auto after = m_entries.begin();
+	while (before != previous.m_entries.end() || after != m_entries.end()) {
+		RMA2_NLA address;
+		uint64_t before_value = 0;
+		uint64_t after_value = 0;
+		if (after == m_entries.end() ||
+		    (before != previous.m_entries.end() && before->address < after->address)) {
+			address = before->address;
+			before_value = (before++)->value;
+		} else if (before == previous.m_entries.end() || after->address < before->address) {
+			address = after->address;
+			after_value = (after++)->value;
+		} else {
+			address = after->address;
+			before_value = (before++)->value;
+			after_value = (after++)->value;
+		}
+
+		if (before_value != after_value && m_range.contains(address) &&
+		    previous.m_range.contains(address)) {
+			differences.push_back({address, before_value, after_value});
+		}
+	}
+	return differences;
+}
+
+} // namespace nhtl_extoll
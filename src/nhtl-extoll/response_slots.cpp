@@ -0,0 +1,116 @@
+#include "nhtl-extoll/response_slots.h"
+
+#include <bit>
+#include <stdexcept>
+#include <thread>
+
+namespace nhtl_extoll {
+
+static_assert(PhysicalBuffer::response_slots % 64 == 0);
+
+ResponseSlots::ResponseSlots(NotificationCounter const* completions) : m_completions(completions)
+{
+	for (auto& word : m_free) {
+		word.store(~uint64_t(0), std::memory_order_relaxed);
+	}
+	m_free[reserved_slot / word_bits].fetch_and(~(uint64_t(1) << (reserved_slot % word_bits)));
+}
+
+std::optional<size_t> ResponseSlots::try_acquire()
+{
+	size_t const start = m_next_word.fetch_add(1, std::memory_order_relaxed);
+	for (size_t i = 0; i < m_free.size(); ++i) {
+		size_t const word = (start + i) % m_free.size();
+		uint64_t bits = m_free[word].load(std::memory_order_relaxed);
+		while (bits != 0) {
+			uint64_t const bit = uint64_t(1) << std::countr_zero(bits);
+			if (m_free[word].compare_exchange_weak(
+			        bits, bits & ~bit, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return word * word_bits + std::countr_zero(bit);
+			}
+		}
+	}
+	return std::nullopt;
+}
+
+size_t ResponseSlots::acquire(
+    std::span<size_t> slots, std::chrono::steady_clock::time_point deadline)
+{
+	size_t acquired = 0;
+	while (acquired < slots.size()) {
+		auto const slot = try_acquire();
+		if (slot) {
+			slots[acquired++] = *slot;
+		} else if (acquired > 0) {
+			break;
+		} else {
+			reclaim();
+			if (available() == 0) {
+				if (std::chrono::steady_clock::now() >= deadline) {
+					break;
+				}
+				std::this_thread::yield();
+			}
+		}
+	}
+	return acquired;
+}
+
+void ResponseSlots::release(size_t slot)
+{
+	if (slot >= PhysicalBuffer::response_slots || slot == reserved_slot) {
+		throw std::out_of_range("Response slot cannot be released.");
+	}
+	m_free[slot / word_bits].fetch_or(uint64_t(1) << (slot % word_bits), std::memory_order_release);
+}
+
+void ResponseSlots::release_after(size_t slot, uint64_t ticket)
+{
+	if (slot >= PhysicalBuffer::response_slots || slot == reserved_slot) {
+		throw std::out_of_range("Response slot cannot be released.");
+	}
+	m_deferred_ticket[slot].store(ticket, std::memory_order_relaxed);
+	m_deferred[slot / word_bits].fetch_or(
+	    uint64_t(1) << (slot % word_bits), std::memory_order_release);
+}
+
+void ResponseSlots::reclaim()
+{
+	if (!m_completions) {
+		return;
+	}
+	uint64_t const completed = m_completions->value();
+	for (size_t word = 0; word < m_deferred.size(); ++word) {
+		uint64_t bits = m_deferred[word].load(std::memory_order_acquire);
+		while (bits != 0) {
+			size_t const slot = word * word_bits + std::countr_zero(bits);
+			uint64_t const bit = uint64_t(1) << (slot % word_bits);
+			bits &= ~bit;
+			if (m_deferred_ticket[slot].load(std::memory_order_relaxed) >= completed) {
+				continue;
+			}
+			// Concurrent callers may reclaim the same slot, only the one clearing its bit
+			// returns it
+			if (!(m_deferred[word].fetch_and(~bit, std::memory_order_acquire) & bit)) {
+				continue;
+			}
+			// The slot may have been deferred again since its ticket was loaded
+			if (m_deferred_ticket[slot].load(std::memory_order_relaxed) >= completed) {
+				m_deferred[word].fetch_or(bit, std::memory_order_release);
+				continue;
+			}
+			release(slot);
+		}
+	}
+}
+
+size_t ResponseSlots::available() const
+{
+	size_t free = 0;
+	for (auto const& word : m_free) {
+		free += std::popcount(word.load(std::memory_order_relaxed));
+	}
+	return free;
+}
+
+} // namespace nhtl_extoll
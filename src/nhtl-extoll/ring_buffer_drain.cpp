@@ -0,0 +1,135 @@
+#include "nhtl-extoll/ring_buffer_drain.h"
+
+namespace nhtl_extoll {
+
+RingBufferDrain::RingBufferDrain(
+    RingBuffer& ring, size_t queue_capacity, size_t max_overflow_words) :
+    m_ring(ring),
+    m_filled(queue_capacity),
+    m_recycled(queue_capacity),
+    m_max_overflow_words(max_overflow_words),
+    m_thread(&RingBufferDrain::drain, this)
+{}
+
+RingBufferDrain::~RingBufferDrain()
+{
+	m_running.store(false);
+	m_thread.join();
+}
+
+void RingBufferDrain::drain()
+{
+	using namespace std::literals::chrono_literals;
+
+	std::vector<uint64_t> batch;
+	while (m_running) {
+		bool const overflow_empty = flush_overflow();
+
+		size_t const words = m_ring.receive_append(batch);
+		if (words == 0) {
+			continue;
+		}
+
+		bool const published = overflow_empty && publish(batch);
+		if (!published && !spill(batch)) {
+			// Queue and overflow are full, wait for the consumer without returning further
+			// credits
+			m_stalls.fetch_add(1, std::memory_order_relaxed);
+			while (m_running && !(flush_overflow() && publish(batch))) {
+				std::this_thread::sleep_for(100us);
+			}
+			if (!m_running) {
+				break;
+			}
+		}
+
+		if (!m_recycled.try_pop(batch)) {
+			batch = std::vector<uint64_t>();
+		}
+		batch.clear();
+	}
+}
+
+bool RingBufferDrain::publish(std::vector<uint64_t>& batch)
+{
+	size_t const words = batch.size();
+	if (!m_filled.try_push(std::move(batch))) {
+		return false;
+	}
+	m_batches.fetch_add(1, std::memory_order_relaxed);
+	m_words.fetch_add(words, std::memory_order_relaxed);
+	m_available.release();
+	return true;
+}
+
+bool RingBufferDrain::spill(std::vector<uint64_t>& batch)
+{
+	size_t const words = batch.size();
+	uint64_t const overflow_words = m_overflow_words.load(std::memory_order_relaxed) + words;
+	if (overflow_words > m_max_overflow_words) {
+		return false;
+	}
+
+	// Newer data queues up behind older spilled batches to keep the order
+	m_overflow.push_back(std::move(batch));
+	m_spilled_words.fetch_add(words, std::memory_order_relaxed);
+	m_overflow_words.store(overflow_words, std::memory_order_relaxed);
+	if (overflow_words > m_peak_overflow_words.load(std::memory_order_relaxed)) {
+		m_peak_overflow_words.store(overflow_words, std::memory_order_relaxed);
+	}
+	return true;
+}
+
+bool RingBufferDrain::flush_overflow()
+{
+	while (!m_overflow.empty()) {
+		size_t const words = m_overflow.front().size();
+		if (!publish(m_overflow.front())) {
+			return false;
+		}
+		m_overflow.pop_front();
+		m_overflow_words.fetch_sub(words, std::memory_order_relaxed);
+	}
+	return true;
+}
+
+void RingBufferDrain::exchange(std::vector<uint64_t>& batch)
+{
+	std::vector<uint64_t> previous = std::move(batch);
+	m_filled.try_pop(batch);
+	// Dropping the previous batch if the recycle queue is full only costs an allocation later
+	if (previous.capacity() > 0) {
+		m_recycled.try_push(std::move(previous));
+	}
+}
+
+bool RingBufferDrain::pop(std::vector<uint64_t>& batch, std::chrono::milliseconds timeout)
+{
+	if (!m_available.try_acquire_for(timeout)) {
+		return false;
+	}
+	exchange(batch);
+	return true;
+}
+
+bool RingBufferDrain::try_pop(std::vector<uint64_t>& batch)
+{
+	if (!m_available.try_acquire()) {
+		return false;
+	}
+	exchange(batch);
+	return true;
+}
+
+RingBufferDrain::Statistics RingBufferDrain::statistics() const
+{
+	return {
+	    m_batches.load(std::memory_order_relaxed),
+	    m_words.load(std::memory_order_relaxed),
+	    m_stalls.load(std::memory_order_relaxed),
+	    m_spilled_words.load(std::memory_order_relaxed),
+	    m_overflow_words.load(std::memory_order_relaxed),
+	    m_peak_overflow_words.load(std::memory_order_relaxed)};
+}
+
+} // namespace nhtl_extoll
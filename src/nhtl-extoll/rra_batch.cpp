@@ -0,0 +1,59 @@
+#include "nhtl-extoll/rra_batch.h"
+
+#include "nhtl-extoll/exception.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace nhtl_extoll {
+
+RraBatch::RraBatch(Endpoint& endpoint, size_t max_in_flight) :
+    m_endpoint(endpoint), m_max_in_flight(max_in_flight)
+{
+	if (m_max_in_flight == 0) {
+		throw std::invalid_argument("Register write batch needs at least one write in flight.");
+	}
+}
+
+RraBatch::~RraBatch()
+{
+	// Errors must not escape the destructor
+	try {
+		flush();
+	} catch (std::exception const& e) {
+		std::cerr << "Completing register writes failed: " << e.what() << "\n";
+	}
+}
+
+void RraBatch::write(RMA2_NLA address, uint64_t value)
+{
+	if (m_in_flight.size() >= m_max_in_flight) {
+		complete_oldest();
+	}
+
+	m_in_flight.push_back({address, m_endpoint.post_write(address, value)});
+}
+
+void RraBatch::flush()
+{
+	while (!m_in_flight.empty()) {
+		complete_oldest();
+	}
+}
+
+size_t RraBatch::in_flight() const
+{
+	return m_in_flight.size();
+}
+
+void RraBatch::complete_oldest()
+{
+	auto const [address, ticket] = m_in_flight.front();
+	if (!m_endpoint.wait_for(ticket, Endpoint::rra_timeout)) {
+		m_in_flight.clear();
+		throw FailedToWrite(m_endpoint.get_node(), address);
+	}
+	m_in_flight.pop_front();
+}
+
+} // namespace nhtl_extoll
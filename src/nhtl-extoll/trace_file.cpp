@@ -0,0 +1,311 @@
+#include "nhtl-extoll/trace_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nhtl_extoll {
+
+namespace {
+
+size_t round_up(size_t size_bt, size_t alignment_bt)
+{
+	return (size_bt + alignment_bt - 1) / alignment_bt * alignment_bt;
+}
+
+int64_t nanoseconds_since_epoch(std::chrono::system_clock::time_point time)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+/// Whether a chunk header with all of its words lies at the offset before the end
+bool chunk_fits(char const* bytes, size_t offset, size_t end_bt)
+{
+	if (offset < TraceFileWriter::alignment_bt || offset % TraceFileWriter::alignment_bt ||
+	    offset > end_bt || end_bt - offset < sizeof(TraceChunkHeader)) {
+		return false;
+	}
+	auto const& header = *reinterpret_cast<TraceChunkHeader const*>(bytes + offset);
+	return header.magic == TraceChunkHeader::magic_value &&
+	       header.size_bt >= sizeof(TraceChunkHeader) && header.size_bt <= end_bt - offset &&
+	       header.words <= (header.size_bt - sizeof(TraceChunkHeader)) / sizeof(uint64_t);
+}
+
+} // namespace
+
+TraceFileWriter::TraceFileWriter(
+    std::filesystem::path const& path,
+    RMA2_Nodeid node,
+    uint64_t identifier,
+    bool direct_io,
+    uint64_t first_sequence) :
+    m_sequence(first_sequence), m_node(node), m_identifier(identifier), m_scratch(nullptr, std::free)
+{
+	int const flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+	m_direct = direct_io;
+	m_fd = m_direct ? open(path.c_str(), flags | O_DIRECT, 0644) : -1;
+	if (m_fd < 0) {
+		m_direct = false;
+		m_fd = open(path.c_str(), flags, 0644);
+	}
+	if (m_fd < 0) {
+		std::cerr << "Opening trace file " << path << " failed: " << std::strerror(errno);
+		throw std::runtime_error("Failed to open trace file.");
+	}
+
+	// The header occupies the whole first page to keep all chunks aligned
+	m_scratch.reset(static_cast<uint64_t*>(std::aligned_alloc(alignment_bt, alignment_bt)));
+	if (!m_scratch) {
+		close(m_fd);
+		throw std::bad_alloc();
+	}
+	m_scratch_size_bt = alignment_bt;
+	std::memset(m_scratch.get(), 0, alignment_bt);
+	TraceFileHeader header{
+	    TraceFileHeader::magic_value, TraceFileHeader::current_version, alignment_bt, m_identifier,
+	    m_node, 0, 0, {}};
+	std::memcpy(m_scratch.get(), &header, sizeof(header));
+	try {
+		write_fully(m_scratch.get(), alignment_bt);
+	} catch (...) {
+		close(m_fd);
+		throw;
+	}
+}
+
+TraceFileWriter::~TraceFileWriter()
+{
+	try {
+		finish();
+	} catch (std::exception const& e) {
+		std::cerr << "Finishing trace file failed: " << e.what() << "\n";
+	}
+}
+
+size_t TraceFileWriter::chunk_size_bt(size_t words)
+{
+	return round_up(chunk_header_size_bt + words * sizeof(uint64_t), alignment_bt);
+}
+
+void TraceFileWriter::write_chunk(
+    void* chunk, size_t words, std::chrono::system_clock::time_point received)
+{
+	size_t const size_bt = chunk_size_bt(words);
+	size_t const used_bt = chunk_header_size_bt + words * sizeof(uint64_t);
+	char* const data = static_cast<char*>(chunk);
+	std::memset(data + used_bt, 0, size_bt - used_bt);
+
+	TraceChunkHeader const header{
+	    TraceChunkHeader::magic_value,
+	    m_sequence,
+	    nanoseconds_since_epoch(received),
+	    words,
+	    size_bt,
+	    m_node,
+	    0,
+	    0,
+	    m_identifier,
+	    0};
+	std::memcpy(data, &header, sizeof(header));
+
+	TraceIndexEntry const entry{m_size_bt, m_sequence, header.timestamp_ns, words};
+	write_fully(data, size_bt);
+	m_index.push_back(entry);
+	++m_sequence;
+}
+
+void TraceFileWriter::append(
+    std::span<uint64_t const> words, std::chrono::system_clock::time_point received)
+{
+	size_t const size_bt = chunk_size_bt(words.size());
+	if (size_bt > m_scratch_size_bt) {
+		m_scratch.reset(static_cast<uint64_t*>(std::aligned_alloc(alignment_bt, size_bt)));
+		if (!m_scratch) {
+			m_scratch_size_bt = 0;
+			throw std::bad_alloc();
+		}
+		m_scratch_size_bt = size_bt;
+	}
+	std::memcpy(
+	    reinterpret_cast<char*>(m_scratch.get()) + chunk_header_size_bt, words.data(),
+	    words.size_bytes());
+	write_chunk(m_scratch.get(), words.size(), received);
+}
+
+void TraceFileWriter::finish()
+{
+	if (m_fd < 0) {
+		return;
+	}
+
+	// Index and footer are not page-aligned in size
+	if (m_direct) {
+		fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+		m_direct = false;
+	}
+	TraceFileFooter const footer{m_size_bt, m_index.size(), 0, TraceFileFooter::magic_value};
+	try {
+		write_fully(m_index.data(), m_index.size() * sizeof(TraceIndexEntry));
+		write_fully(&footer, sizeof(footer));
+	} catch (...) {
+		close(m_fd);
+		m_fd = -1;
+		throw;
+	}
+	close(m_fd);
+	m_fd = -1;
+}
+
+size_t TraceFileWriter::size_bt() const
+{
+	return m_size_bt;
+}
+
+uint64_t TraceFileWriter::next_sequence() const
+{
+	return m_sequence;
+}
+
+void TraceFileWriter::write_fully(void const* data, size_t size_bt)
+{
+	char const* bytes = static_cast<char const*>(data);
+	while (size_bt > 0) {
+		ssize_t const written = write(m_fd, bytes, size_bt);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::cerr << "Writing trace file failed: " << std::strerror(errno);
+			throw std::runtime_error("Failed to write trace file.");
+		}
+		bytes += written;
+		size_bt -= written;
+		m_size_bt += written;
+	}
+}
+
+TraceFileReader::TraceFileReader(std::filesystem::path const& path)
+{
+	int const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		std::cerr << "Opening trace file " << path << " failed: " << std::strerror(errno);
+		throw std::runtime_error("Failed to open trace file.");
+	}
+	struct stat status;
+	if (fstat(fd, &status) < 0) {
+		std::cerr << "Querying trace file " << path << " failed: " << std::strerror(errno);
+		close(fd);
+		throw std::runtime_error("Failed to query trace file size.");
+	}
+	m_size_bt = status.st_size;
+	if (m_size_bt < TraceFileWriter::alignment_bt) {
+		close(fd);
+		throw std::runtime_error("Trace file too small for its header.");
+	}
+	m_map = mmap(nullptr, m_size_bt, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (m_map == MAP_FAILED) {
+		std::cerr << "Mapping trace file " << path << " failed: " << std::strerror(errno);
+		throw std::runtime_error("Failed to map trace file.");
+	}
+
+	if (header().magic != TraceFileHeader::magic_value ||
+	    header().version != TraceFileHeader::current_version) {
+		munmap(m_map, m_size_bt);
+		throw std::runtime_error("File is no trace file of a supported version.");
+	}
+
+	auto const bytes = static_cast<char const*>(m_map);
+	TraceFileFooter footer;
+	std::memcpy(&footer, bytes + m_size_bt - sizeof(footer), sizeof(footer));
+	bool const finished = footer.magic == TraceFileFooter::magic_value &&
+	                      footer.index_offset <= m_size_bt - sizeof(footer) &&
+	                      footer.entries <= m_size_bt / sizeof(TraceIndexEntry) &&
+	                      footer.entries * sizeof(TraceIndexEntry) ==
+	                          m_size_bt - sizeof(footer) - footer.index_offset;
+	if (finished) {
+		m_index = {
+		    reinterpret_cast<TraceIndexEntry const*>(bytes + footer.index_offset),
+		    footer.entries};
+	}
+	// A corrupt index must not hand out spans beyond the mapping
+	bool const valid =
+	    finished && std::all_of(m_index.begin(), m_index.end(), [&](auto const& entry) {
+		    return chunk_fits(bytes, entry.offset, footer.index_offset) &&
+		           reinterpret_cast<TraceChunkHeader const*>(bytes + entry.offset)->words ==
+		               entry.words;
+	    });
+	if (!valid) {
+		recover_index();
+	}
+}
+
+TraceFileReader::~TraceFileReader()
+{
+	munmap(m_map, m_size_bt);
+}
+
+void TraceFileReader::recover_index()
+{
+	auto const bytes = static_cast<char const*>(m_map);
+	size_t offset = TraceFileWriter::alignment_bt;
+	while (chunk_fits(bytes, offset, m_size_bt)) {
+		auto const& header = *reinterpret_cast<TraceChunkHeader const*>(bytes + offset);
+		m_recovered_index.push_back({offset, header.sequence, header.timestamp_ns, header.words});
+		offset += header.size_bt;
+	}
+	m_index = m_recovered_index;
+	m_recovered = true;
+}
+
+TraceFileHeader const& TraceFileReader::header() const
+{
+	return *static_cast<TraceFileHeader const*>(m_map);
+}
+
+std::span<TraceIndexEntry const> TraceFileReader::index() const
+{
+	return m_index;
+}
+
+size_t TraceFileReader::size() const
+{
+	return m_index.size();
+}
+
+TraceChunk TraceFileReader::chunk(size_t position) const
+{
+	if (position >= size()) {
+		throw std::out_of_range("No such chunk in trace file.");
+	}
+	TraceIndexEntry const& entry = m_index[position];
+	auto const bytes = static_cast<char const*>(m_map);
+	auto const& header = *reinterpret_cast<TraceChunkHeader const*>(bytes + entry.offset);
+	return {
+	    header,
+	    {reinterpret_cast<uint64_t const*>(bytes + entry.offset + sizeof(TraceChunkHeader)),
+	     header.words}};
+}
+
+size_t TraceFileReader::find(std::chrono::system_clock::time_point time) const
+{
+	int64_t const timestamp_ns = nanoseconds_since_epoch(time);
+	auto const it = std::lower_bound(
+	    m_index.begin(), m_index.end(), timestamp_ns,
+	    [](TraceIndexEntry const& entry, int64_t value) { return entry.timestamp_ns < value; });
+	return it - m_index.begin();
+}
+
+bool TraceFileReader::recovered() const
+{
+	return m_recovered;
+}
+
+} // namespace nhtl_extoll
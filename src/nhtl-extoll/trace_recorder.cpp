@@ -0,0 +1,254 @@
+#include "nhtl-extoll/trace_recorder.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace nhtl_extoll {
+
+TraceRecorder::TraceRecorder(RingBuffer& ring, TraceRecorderOptions options) :
+    m_ring(ring),
+    m_options(std::move(options)),
+    m_buffer_size_qw(m_options.buffer_size_bt / sizeof(uint64_t)),
+    m_data_offset_qw(
+        m_options.format == TraceRecorderOptions::Format::indexed
+            ? TraceFileWriter::chunk_header_size_bt / sizeof(uint64_t)
+            : 0),
+    m_filled(m_options.buffers + 1),
+    m_free(m_options.buffers),
+    m_start(std::chrono::steady_clock::now())
+{
+	if (m_options.buffer_size_bt == 0 ||
+	    m_options.buffer_size_bt % RingBuffer::page_size_bt != 0) {
+		throw std::invalid_argument("Recorder buffer size must be a multiple of 4096B.");
+	}
+	if (m_options.buffers == 0) {
+		throw std::invalid_argument("Recorder needs at least one buffer.");
+	}
+
+	for (size_t i = 0; i < m_options.buffers; ++i) {
+		void* buffer = std::aligned_alloc(RingBuffer::page_size_bt, m_options.buffer_size_bt);
+		if (buffer == nullptr) {
+			throw std::bad_alloc();
+		}
+		m_buffers.emplace_back(static_cast<uint64_t*>(buffer), std::free);
+		m_free.try_push(size_t(i));
+		m_free_available.release();
+	}
+
+	open_next_file();
+
+	m_writer = std::thread(&TraceRecorder::write, this);
+	m_receiver = std::thread(&TraceRecorder::receive, this);
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	try {
+		stop();
+	} catch (std::exception const& e) {
+		std::cerr << "Trace recording failed: " << e.what() << "\n";
+	}
+}
+
+void TraceRecorder::stop()
+{
+	if (m_receiver.joinable()) {
+		m_running.store(false);
+		m_receiver.join();
+		m_writer.join();
+		if (m_file_writer) {
+			try {
+				m_file_writer->finish();
+			} catch (...) {
+				if (!m_error) {
+					m_error = std::current_exception();
+				}
+			}
+		}
+		if (m_fd >= 0) {
+			close(m_fd);
+			m_fd = -1;
+		}
+	}
+	if (m_error) {
+		std::rethrow_exception(std::exchange(m_error, nullptr));
+	}
+}
+
+void TraceRecorder::receive()
+{
+	using namespace std::literals::chrono_literals;
+
+	// Drops words into a scratch buffer while no pool buffer is free
+	std::vector<uint64_t> scratch;
+	if (m_options.drop_on_overrun) {
+		scratch.resize(m_buffer_size_qw);
+	}
+
+	size_t const capacity = m_buffer_size_qw - m_data_offset_qw;
+	size_t current = stop_index;
+	size_t filled = 0;
+	std::chrono::system_clock::time_point received;
+	while (m_running) {
+		if (current == stop_index) {
+			if (m_free_available.try_acquire_for(m_options.drop_on_overrun ? 0ms : 20ms)) {
+				m_free.try_pop(current);
+			} else if (m_options.drop_on_overrun) {
+				size_t const words = m_ring.receive_into(scratch);
+				m_received_words.fetch_add(words, std::memory_order_relaxed);
+				m_dropped_words.fetch_add(words, std::memory_order_relaxed);
+				continue;
+			} else {
+				continue;
+			}
+		}
+
+		size_t const words = m_ring.receive_into(
+		    {m_buffers[current].get() + m_data_offset_qw + filled, capacity - filled});
+		if (filled == 0 && words > 0) {
+			received = std::chrono::system_clock::now();
+		}
+		m_received_words.fetch_add(words, std::memory_order_relaxed);
+		filled += words;
+
+		if (filled == capacity) {
+			m_filled.try_push({current, filled, received});
+			m_filled_available.release();
+			current = stop_index;
+			filled = 0;
+		}
+	}
+
+	if (current != stop_index && filled > 0) {
+		m_filled.try_push({current, filled, received});
+		m_filled_available.release();
+	}
+	m_filled.try_push({stop_index, 0, {}});
+	m_filled_available.release();
+}
+
+void TraceRecorder::write()
+{
+	while (true) {
+		m_filled_available.acquire();
+		Filled buffer{};
+		m_filled.try_pop(buffer);
+		if (buffer.index == stop_index) {
+			return;
+		}
+
+		size_t const size_bt = m_file_writer ? TraceFileWriter::chunk_size_bt(buffer.words)
+		                                     : buffer.words * sizeof(uint64_t);
+		// Size of a file without any recorded words
+		size_t const empty_size_bt = m_file_writer ? TraceFileWriter::alignment_bt : 0;
+		if (!m_error) {
+			try {
+				if (m_options.max_file_size_bt != 0 && m_file_size_bt > empty_size_bt &&
+				    m_file_size_bt + size_bt > m_options.max_file_size_bt) {
+					open_next_file();
+				}
+				if (m_file_writer) {
+					// Chunks are padded to full pages, so direct I/O stays enabled
+					m_file_writer->write_chunk(
+					    m_buffers[buffer.index].get(), buffer.words, buffer.received);
+					m_file_size_bt += size_bt;
+					m_written_bt.fetch_add(size_bt, std::memory_order_relaxed);
+				} else {
+					// Direct I/O requires page-aligned sizes, only the last buffer may be partial
+					if (m_direct && size_bt % RingBuffer::page_size_bt != 0) {
+						fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+						m_direct = false;
+					}
+					write_fully(
+					    reinterpret_cast<char const*>(m_buffers[buffer.index].get()), size_bt);
+				}
+			} catch (...) {
+				m_error = std::current_exception();
+			}
+		}
+		if (m_error) {
+			m_dropped_words.fetch_add(buffer.words, std::memory_order_relaxed);
+		}
+
+		m_free.try_push(size_t(buffer.index));
+		m_free_available.release();
+	}
+}
+
+void TraceRecorder::open_next_file()
+{
+	if (m_fd >= 0) {
+		close(m_fd);
+		m_fd = -1;
+	}
+
+	std::string path = m_options.path.string();
+	if (m_options.max_file_size_bt != 0) {
+		path += "." + std::to_string(m_files.load(std::memory_order_relaxed));
+	}
+
+	if (m_options.format == TraceRecorderOptions::Format::indexed) {
+		uint64_t const sequence = m_file_writer ? m_file_writer->next_sequence() : 0;
+		// Finish the previous file before the next one is created
+		if (m_file_writer) {
+			m_file_writer->finish();
+		}
+		m_file_writer.reset();
+		m_file_writer.emplace(
+		    path, m_options.node, m_options.identifier, m_options.direct_io, sequence);
+		m_file_size_bt = m_file_writer->size_bt();
+		m_written_bt.fetch_add(m_file_size_bt, std::memory_order_relaxed);
+		m_files.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	int const flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+	m_direct = m_options.direct_io;
+	m_fd = m_direct ? open(path.c_str(), flags | O_DIRECT, 0644) : -1;
+	if (m_fd < 0) {
+		m_direct = false;
+		m_fd = open(path.c_str(), flags, 0644);
+	}
+	if (m_fd < 0) {
+		std::cerr << "Opening trace file " << path << " failed: " << std::strerror(errno);
+		throw std::runtime_error("Failed to open trace file.");
+	}
+	m_file_size_bt = 0;
+	m_files.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TraceRecorder::write_fully(char const* data, size_t size_bt)
+{
+	while (size_bt > 0) {
+		ssize_t const written = ::write(m_fd, data, size_bt);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::cerr << "Writing trace file failed: " << std::strerror(errno);
+			throw std::runtime_error("Failed to write trace file.");
+		}
+		data += written;
+		size_bt -= written;
+		m_file_size_bt += written;
+		m_written_bt.fetch_add(written, std::memory_order_relaxed);
+	}
+}
+
+TraceRecorder::Statistics TraceRecorder::statistics() const
+{
+	return {
+	    m_received_words.load(std::memory_order_relaxed),
+	    m_written_bt.load(std::memory_order_relaxed),
+	    m_dropped_words.load(std::memory_order_relaxed),
+	    m_files.load(std::memory_order_relaxed),
+	    std::chrono::steady_clock::now() - m_start};
+}
+
+} // namespace nhtl_extoll
@@ -1,10 +1,19 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
 #include <cstdint>
+#include <functional>
+#include <future>
+#include <span>
+#include <thread>
 #include <vector>
 #include <gtest/gtest.h>
 
 #include "nhtl-extoll/configure_fpga.h"
 #include "nhtl-extoll/connection.h"
 #include "nhtl-extoll/get_node_ids.h"
+#include "nhtl-extoll/rra_batch.h"
 #include "rma2.h"
 
 TEST(DISABLED_TestExtollFPGA, CheckLinks)
@@ -61,3 +70,175 @@ TEST(DISABLED_TestExtollFPGA, ConfigureFPGA)
 	}
 	ASSERT_GE(fpga_count, node_ids.size());
 }
+
+TEST(DISABLED_TestExtollFPGA, ConfigureFPGAWithOptions)
+{
+	using namespace nhtl_extoll;
+	EndpointOptions options;
+	options.hicann_ring = false;
+	options.trace_ring_pages = 4096;
+	options.send_buffer_pages = 1;
+
+	Endpoint connection{get_fpga_node_id(), options};
+	EXPECT_FALSE(connection.hicann_ring_buffer);
+	EXPECT_EQ(connection.buffer.send_buffer_size_qw(), RingBuffer::page_size_qw);
+	configure_fpga(connection);
+	EXPECT_EQ(
+	    connection.rra_read<TraceBufferStart>().data(), connection.trace_ring_buffer.address(0));
+	EXPECT_EQ(connection.rra_read<TraceBufferSize>().data(), connection.trace_ring_buffer.size_bt);
+}
+
+TEST(DISABLED_TestExtollFPGA, BatchWrites)
+{
+	using namespace nhtl_extoll;
+	Endpoint connection{get_fpga_node_id()};
+	configure_fpga(connection);
+
+	auto const start = connection.rra_read<TraceBufferStart>().data();
+	auto const size = connection.rra_read<TraceBufferSize>().data();
+	{
+		RraBatch batch(connection, 2);
+		for (uint32_t i = 0; i < 8; ++i) {
+			batch.write<TraceBufferSize>({size + i});
+			EXPECT_LE(batch.in_flight(), 2);
+		}
+		batch.write<TraceBufferStart>({start});
+		batch.flush();
+		EXPECT_EQ(batch.in_flight(), 0);
+	}
+	EXPECT_EQ(connection.rra_read<TraceBufferSize>().data(), size + 7);
+
+	configure_fpga(connection);
+	EXPECT_EQ(connection.rra_read<TraceBufferSize>().data(), size);
+}
+
+TEST(DISABLED_TestExtollFPGA, BatchReads)
+{
+	using namespace nhtl_extoll;
+	Endpoint connection{get_fpga_node_id()};
+	configure_fpga(connection);
+
+	// More addresses than response slots, so the reads are split into two rounds
+	std::vector<RMA2_NLA> addresses(PhysicalBuffer::response_slots + 100, 0x8000);
+	addresses.back() = TraceBufferStart::rf_address;
+	auto const values = connection.rra_read(addresses);
+	ASSERT_EQ(values.size(), addresses.size());
+	for (size_t i = 0; i + 1 < values.size(); ++i) {
+		EXPECT_EQ(values[i], 0xcafebabe);
+	}
+	EXPECT_EQ(values.back(), connection.trace_ring_buffer.address(0));
+	EXPECT_TRUE(connection.rra_read(std::span<RMA2_NLA const>()).empty());
+}
+
+TEST(DISABLED_TestExtollFPGA, SnapshotRegisters)
+{
+	using namespace nhtl_extoll;
+	Endpoint connection{get_fpga_node_id()};
+	configure_fpga(connection);
+
+	auto const before = connection.snapshot_registers();
+	EXPECT_EQ(before.value(0x8000), 0xcafebabe);
+	EXPECT_EQ(before.value(TraceBufferStart::rf_address), connection.trace_ring_buffer.address(0));
+
+	auto const size = connection.rra_read<TraceBufferSize>().data();
+	connection.rra_write<TraceBufferSize>({size + 8});
+	auto const after = connection.snapshot_registers(
+	    {TraceBufferSize::rf_address, TraceBufferSize::rf_address});
+	auto const differences = after.diff(before);
+	ASSERT_EQ(differences.size(), 1);
+	EXPECT_EQ(differences[0].after, size + 8);
+
+	EXPECT_THROW(
+	    connection.snapshot_registers({0, Endpoint::max_address + 8}), std::invalid_argument);
+	configure_fpga(connection);
+}
+
+TEST(DISABLED_TestExtollFPGA, ConcurrentAccess)
+{
+	using namespace nhtl_extoll;
+	Endpoint connection{get_fpga_node_id()};
+	configure_fpga(connection);
+	auto const trace_start = connection.trace_ring_buffer.address(0);
+
+	// A monitoring and a control thread sharing the endpoint without external locking
+	std::atomic<size_t> mismatches{0};
+	std::thread monitor([&] {
+		for (int i = 0; i < 1000; ++i) {
+			mismatches += connection.rra_read(0x8000) != 0xcafebabe;
+		}
+	});
+	for (int i = 0; i < 1000; ++i) {
+		mismatches += connection.rra_read<TraceBufferStart>().data() != trace_start;
+		connection.rra_write<HicannTracePktClosure>({512});
+	}
+	monitor.join();
+	EXPECT_EQ(mismatches, 0);
+}
+
+namespace {
+
+/// Minimal coroutine type running eagerly until the first suspension
+struct DetachedTask
+{
+	struct promise_type
+	{
+		DetachedTask get_return_object()
+		{
+			return {};
+		}
+		std::suspend_never initial_suspend()
+		{
+			return {};
+		}
+		std::suspend_never final_suspend() noexcept
+		{
+			return {};
+		}
+		void return_void() {}
+		void unhandled_exception()
+		{
+			std::terminate();
+		}
+	};
+};
+
+DetachedTask read_identifier(nhtl_extoll::Endpoint const& connection, std::promise<uint64_t>& value)
+{
+	value.set_value(co_await connection.rra_read_async(0x8000));
+}
+
+} // namespace
+
+TEST(DISABLED_TestExtollFPGA, ReadAsync)
+{
+	using namespace nhtl_extoll;
+	Endpoint connection{get_fpga_node_id()};
+
+	std::promise<uint64_t> value;
+	auto result = value.get_future();
+	read_identifier(connection, value);
+	ASSERT_EQ(result.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+	EXPECT_EQ(result.get(), 0xcafebabe);
+}
+
+TEST(DISABLED_TestExtollFPGA, CompletionTokens)
+{
+	using namespace nhtl_extoll;
+	Endpoint connection{get_fpga_node_id()};
+	configure_fpga(connection);
+
+	auto const size = connection.rra_read<TraceBufferSize>().data();
+	auto write = connection.rra_write_async(TraceBufferSize::rf_address, size + 1);
+	auto identifier = connection.rra_read_async(0x8000);
+	auto written = connection.rra_read_async(TraceBufferSize::rf_address);
+	EXPECT_EQ(written.address(), TraceBufferSize::rf_address);
+
+	std::array<std::reference_wrapper<Endpoint::RraCompletion const>, 3> const tokens{
+	    write, identifier, written};
+	ASSERT_TRUE(Endpoint::wait_all(tokens));
+	EXPECT_TRUE(write.ready());
+	EXPECT_EQ(identifier.get(), 0xcafebabe);
+	EXPECT_EQ(written.get(), size + 1);
+
+	configure_fpga(connection);
+}
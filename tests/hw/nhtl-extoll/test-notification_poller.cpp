@@ -0,0 +1,215 @@
+#include <chrono>
+#include <coroutine>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "nhtl-extoll/buffer.h"
+#include "nhtl-extoll/notification_counter.h"
+#include "nhtl-extoll/notification_poller.h"
+#include "nhtl-extoll/poller_group.h"
+#include "rma2.h"
+
+TEST(DISABLED_TestNotificationPoller, CompareStrategies)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+
+	RMA2_Port port;
+	ASSERT_EQ(rma2_open(&port), RMA2_SUCCESS);
+
+	std::chrono::nanoseconds busy_spin_cpu_time{};
+	std::chrono::nanoseconds blocking_cpu_time{};
+	for (auto const& policy :
+	     {PollingPolicy::busy_spin(), PollingPolicy::hybrid(), PollingPolicy::backoff(),
+	      PollingPolicy::blocking()}) {
+		auto poller = std::make_unique<NotificationPoller>(port, policy);
+		std::this_thread::sleep_for(1s);
+		auto const statistics = poller->statistics();
+
+		// Shutdown has to wake up the idle poller thread just like a notification would
+		auto const start = std::chrono::steady_clock::now();
+		poller.reset();
+		auto const wake_up = std::chrono::steady_clock::now() - start;
+
+		std::cout << "Strategy " << static_cast<int>(policy.strategy) << ": idle CPU time "
+		          << std::chrono::duration_cast<std::chrono::microseconds>(statistics.cpu_time)
+		                 .count()
+		          << "us per second, wake-up after "
+		          << std::chrono::duration_cast<std::chrono::microseconds>(wake_up).count()
+		          << "us\n";
+		EXPECT_EQ(statistics.notifications, 0);
+		EXPECT_LT(wake_up, 100ms);
+
+		if (policy.strategy == PollingPolicy::Strategy::busy_spin) {
+			busy_spin_cpu_time = statistics.cpu_time;
+		} else if (policy.strategy == PollingPolicy::Strategy::blocking) {
+			blocking_cpu_time = statistics.cpu_time;
+		}
+	}
+	EXPECT_LT(blocking_cpu_time, busy_spin_cpu_time / 10);
+
+	rma2_close(port);
+}
+
+TEST(DISABLED_TestNotificationPoller, GroupSharesThreads)
+{
+	using namespace nhtl_extoll;
+	constexpr size_t ports = 4;
+
+	EXPECT_THROW(PollerGroup(1, PollingPolicy::blocking()), std::invalid_argument);
+
+	PollerGroup group(2, PollingPolicy::hybrid());
+	std::vector<RMA2_Port> handles(ports);
+	std::vector<std::unique_ptr<NotificationPoller>> pollers;
+	for (auto& port : handles) {
+		ASSERT_EQ(rma2_open(&port), RMA2_SUCCESS);
+		pollers.push_back(std::make_unique<NotificationPoller>(port, group));
+	}
+	EXPECT_EQ(group.threads(), 2);
+	EXPECT_EQ(group.size(), ports);
+	EXPECT_EQ(pollers.front()->consume_packets(std::chrono::milliseconds(10)), 0);
+
+	pollers.clear();
+	EXPECT_EQ(group.size(), 0);
+	for (auto port : handles) {
+		rma2_close(port);
+	}
+}
+
+TEST(DISABLED_TestNotificationPoller, ReceiveHonoursDeadline)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+
+	RMA2_Port port;
+	ASSERT_EQ(rma2_open(&port), RMA2_SUCCESS);
+	{
+		NotificationPoller poller(port, PollingPolicy::hybrid());
+		RingBuffer ring(port, nullptr, poller, 16);
+
+		// Nothing is sent to an idle port, so the call has to return at the deadline
+		auto const start = std::chrono::steady_clock::now();
+		EXPECT_TRUE(ring.receive(1, 1024, start + 5ms).empty());
+		auto const waited = std::chrono::steady_clock::now() - start;
+		EXPECT_GE(waited, 5ms);
+		EXPECT_LT(waited, 50ms);
+
+		EXPECT_THROW(ring.receive(2, 1, start), std::invalid_argument);
+	}
+	rma2_close(port);
+}
+
+TEST(DISABLED_TestNotificationPoller, CustomResponseHandler)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+
+	RMA2_Port port;
+	ASSERT_EQ(rma2_open(&port), RMA2_SUCCESS);
+	RMA2_Handle handle;
+	ASSERT_EQ(
+	    rma2_connect(
+	        port, rma2_get_nodeid(port), rma2_get_vpid(port), RMA2_CONN_DEFAULT, &handle),
+	    RMA2_SUCCESS);
+	auto const post_response = [&] {
+		return rma2_post_notification(
+		    port, handle, NotificationPoller::response_class, 0, RMA2_NO_NOTIFICATION,
+		    RMA2_CMD_DEFAULT);
+	};
+	auto const readable = [](int fd) {
+		pollfd entry{fd, POLLIN, 0};
+		return ::poll(&entry, 1, 100) == 1;
+	};
+	{
+		NotificationPoller poller(port, PollingPolicy::hybrid());
+		poller.set_latency_measurement(true);
+
+		// The built-in counter makes the descriptor readable until the response is consumed
+		ASSERT_EQ(post_response(), RMA2_SUCCESS);
+		EXPECT_TRUE(readable(poller.event_fd()));
+		EXPECT_TRUE(poller.try_consume_response());
+		EXPECT_FALSE(readable(poller.event_fd()));
+		EXPECT_EQ(poller.response_latency().count(), 1);
+
+		// Like for the RRA poller of an Endpoint, a custom handler takes over all responses
+		NotificationCounter responses;
+		poller.set_handler(
+		    NotificationPoller::response_class,
+		    NotificationPoller::count_notifications(responses));
+		ASSERT_EQ(post_response(), RMA2_SUCCESS);
+		EXPECT_TRUE(responses.wait_until(1, 1s));
+		EXPECT_FALSE(readable(poller.event_fd()));
+		EXPECT_EQ(poller.response_latency().count(), 1);
+		EXPECT_THROW(poller.try_consume_response(), std::logic_error);
+		EXPECT_THROW(poller.next_response(std::chrono::steady_clock::now()), std::logic_error);
+		EXPECT_EQ(poller.try_consume_packets(), 0);
+	}
+	rma2_disconnect(port, handle);
+	rma2_close(port);
+}
+
+namespace {
+
+/// Minimal coroutine type running eagerly until the first suspension
+struct DetachedTask
+{
+	struct promise_type
+	{
+		DetachedTask get_return_object()
+		{
+			return {};
+		}
+		std::suspend_never initial_suspend()
+		{
+			return {};
+		}
+		std::suspend_never final_suspend() noexcept
+		{
+			return {};
+		}
+		void return_void() {}
+		void unhandled_exception()
+		{
+			std::terminate();
+		}
+	};
+};
+
+DetachedTask await_response(
+    nhtl_extoll::NotificationPoller& poller,
+    std::chrono::steady_clock::time_point deadline,
+    std::promise<bool>& responded)
+{
+	responded.set_value(co_await poller.next_response(deadline));
+}
+
+} // namespace
+
+TEST(DISABLED_TestNotificationPoller, BlockingHonoursAwaiterDeadline)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+
+	RMA2_Port port;
+	ASSERT_EQ(rma2_open(&port), RMA2_SUCCESS);
+	{
+		NotificationPoller poller(port, PollingPolicy::blocking());
+		// Let the poller thread block in the driver before the coroutine suspends
+		std::this_thread::sleep_for(10ms);
+
+		std::promise<bool> responded;
+		auto result = responded.get_future();
+		auto const start = std::chrono::steady_clock::now();
+		await_response(poller, start + 5ms, responded);
+		ASSERT_EQ(result.wait_for(1s), std::future_status::ready);
+		EXPECT_FALSE(result.get());
+		EXPECT_LT(std::chrono::steady_clock::now() - start, 100ms);
+	}
+	rma2_close(port);
+}
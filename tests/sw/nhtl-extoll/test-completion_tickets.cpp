@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "nhtl-extoll/completion_tickets.h"
+
+TEST(CompletionTickets, CompleteInPostingOrder)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	CompletionTickets tickets(1s);
+
+	uint64_t first;
+	{
+		auto const lock = tickets.lock_posting();
+		first = tickets.issue(lock);
+		EXPECT_EQ(tickets.issue(lock, 2), first + 1);
+	}
+	EXPECT_EQ(first, 0);
+
+	tickets.complete();
+	EXPECT_TRUE(tickets.completed(0));
+	EXPECT_FALSE(tickets.completed(1));
+
+	std::thread completer([&] {
+		std::this_thread::sleep_for(1ms);
+		tickets.complete();
+		tickets.complete();
+	});
+	EXPECT_TRUE(tickets.wait_for(2, 1s));
+	completer.join();
+	EXPECT_EQ(tickets.completions(), 3);
+}
+
+TEST(CompletionTickets, RecoversFromLostCompletion)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	CompletionTickets tickets(20ms);
+
+	// The completion of the first access is lost, the one of the second arrives
+	uint64_t lost;
+	uint64_t late;
+	{
+		auto const lock = tickets.lock_posting();
+		lost = tickets.issue(lock);
+		late = tickets.issue(lock);
+	}
+	tickets.complete();
+	EXPECT_TRUE(tickets.completed(lost));
+	EXPECT_FALSE(tickets.completed(late));
+
+	// Abandoning the access before it is overdue does not resynchronize
+	EXPECT_FALSE(tickets.wait_for(late, 1ms));
+	tickets.abandon(late);
+	EXPECT_FALSE(tickets.completed(late));
+
+	// Once it is overdue, the missing completion is treated as lost
+	std::this_thread::sleep_for(20ms);
+	EXPECT_FALSE(tickets.wait_for(late, 1ms));
+	tickets.abandon(late);
+	EXPECT_TRUE(tickets.completed(late));
+
+	// Later accesses are matched to their own completions again
+	uint64_t next;
+	{
+		auto const lock = tickets.lock_posting();
+		next = tickets.issue(lock);
+	}
+	EXPECT_FALSE(tickets.completed(next));
+	tickets.complete();
+	EXPECT_TRUE(tickets.wait_for(next, 0ms));
+}
+
+TEST(CompletionTickets, CompletionTimes)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	CompletionTickets tickets(1ms);
+
+	uint64_t first;
+	{
+		auto const lock = tickets.lock_posting();
+		first = tickets.issue(lock, 3);
+	}
+	auto const before = std::chrono::steady_clock::now();
+	tickets.complete(true);
+	tickets.complete(false);
+	EXPECT_GE(tickets.completed_at(first), before);
+	EXPECT_LE(tickets.completed_at(first), std::chrono::steady_clock::now());
+	EXPECT_FALSE(tickets.completed_at(first + 1));
+	EXPECT_FALSE(tickets.completed_at(first + 2));
+
+	// A lost completion has no time, even if an old one is left at its index
+	std::this_thread::sleep_for(1ms);
+	tickets.abandon(first + 2);
+	EXPECT_TRUE(tickets.completed(first + 2));
+	EXPECT_FALSE(tickets.completed_at(first + 2));
+
+	// Completion times are only kept for the most recent accesses
+	for (size_t i = 0; i < CompletionTickets::history; ++i) {
+		{
+			auto const lock = tickets.lock_posting();
+			tickets.issue(lock);
+		}
+		tickets.complete(true);
+	}
+	EXPECT_FALSE(tickets.completed_at(first));
+	EXPECT_TRUE(tickets.completed_at(first + CompletionTickets::history + 2));
+}
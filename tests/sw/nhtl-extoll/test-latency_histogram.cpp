@@ -0,0 +1,82 @@
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "nhtl-extoll/latency_histogram.h"
+
+TEST(LatencyHistogram, Percentiles)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	LatencyHistogram histogram;
+
+	EXPECT_EQ(histogram.count(), 0);
+	EXPECT_EQ(histogram.percentile(0.5), 0ns);
+
+	for (int64_t latency = 1; latency <= 1000; ++latency) {
+		histogram.record(std::chrono::microseconds(latency));
+	}
+	histogram.record(-1ns);
+
+	EXPECT_EQ(histogram.count(), 1001);
+	EXPECT_EQ(histogram.max(), 1000us);
+	EXPECT_NEAR(histogram.mean().count(), 500000, 1000);
+	// Buckets are at most 1/16 wide relative to their lower bound
+	EXPECT_NEAR(histogram.percentile(0.5).count(), 500000, 500000 / 16);
+	EXPECT_NEAR(histogram.percentile(0.99).count(), 990000, 990000 / 16);
+	EXPECT_EQ(histogram.percentile(1.), 1000us);
+	EXPECT_EQ(histogram.percentile(0.), 0ns);
+
+	auto const buckets = histogram.buckets();
+	ASSERT_FALSE(buckets.empty());
+	EXPECT_EQ(buckets.front().lower, 0ns);
+	EXPECT_EQ(buckets.front().count, 1);
+	uint64_t total = 0;
+	for (size_t i = 0; i < buckets.size(); ++i) {
+		EXPECT_LE(buckets[i].lower, buckets[i].upper);
+		if (i > 0) {
+			EXPECT_LT(buckets[i - 1].upper, buckets[i].lower);
+		}
+		total += buckets[i].count;
+	}
+	EXPECT_EQ(total, 1001);
+
+	histogram.reset();
+	EXPECT_EQ(histogram.count(), 0);
+	EXPECT_TRUE(histogram.buckets().empty());
+}
+
+TEST(LatencyHistogram, ExactSmallValuesAndConcurrentRecording)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	LatencyHistogram histogram;
+
+	for (int64_t latency = 0; latency < 32; ++latency) {
+		histogram.record(std::chrono::nanoseconds(latency));
+	}
+	auto const buckets = histogram.buckets();
+	ASSERT_EQ(buckets.size(), 32);
+	for (int64_t latency = 0; latency < 32; ++latency) {
+		EXPECT_EQ(buckets[latency].lower, std::chrono::nanoseconds(latency));
+		EXPECT_EQ(buckets[latency].upper, std::chrono::nanoseconds(latency));
+	}
+	histogram.reset();
+
+	constexpr int64_t recordings = 100000;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i) {
+		threads.emplace_back([&histogram] {
+			for (int64_t latency = 0; latency < recordings; ++latency) {
+				histogram.record(std::chrono::nanoseconds(latency));
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_EQ(histogram.count(), 4 * recordings);
+	EXPECT_EQ(histogram.max(), std::chrono::nanoseconds(recordings - 1));
+}
@@ -0,0 +1,91 @@
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "nhtl-extoll/notification_counter.h"
+
+TEST(NotificationCounter, ConsumeAndTimeout)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	NotificationCounter counter;
+
+	auto const start = std::chrono::steady_clock::now();
+	EXPECT_EQ(counter.consume_all(10ms), 0);
+	EXPECT_FALSE(counter.consume_one(0ms));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, 10ms);
+
+	counter.add(3);
+	EXPECT_TRUE(counter.consume_one(0ms));
+	EXPECT_EQ(counter.value(), 2);
+	EXPECT_EQ(counter.consume_all(0ms), 2);
+	EXPECT_EQ(counter.value(), 0);
+}
+
+TEST(NotificationCounter, RaiseTo)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	NotificationCounter counter;
+	counter.add(5);
+
+	counter.raise_to(3);
+	EXPECT_EQ(counter.value(), 5);
+
+	std::thread raiser([&] {
+		std::this_thread::sleep_for(1ms);
+		counter.raise_to(8);
+	});
+	EXPECT_TRUE(counter.wait_until(8, 1s));
+	raiser.join();
+	EXPECT_EQ(counter.value(), 8);
+}
+
+TEST(NotificationCounter, WakesParkedConsumer)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	NotificationCounter counter;
+	constexpr uint64_t additions = 10000;
+
+	std::thread producer([&] {
+		for (uint64_t i = 0; i < additions; ++i) {
+			counter.add(1);
+			if (i % 100 == 0) {
+				std::this_thread::sleep_for(10us);
+			}
+		}
+	});
+
+	uint64_t consumed = 0;
+	while (consumed < additions) {
+		uint64_t const value = counter.consume_all(1s);
+		ASSERT_GT(value, 0);
+		consumed += value;
+	}
+	producer.join();
+	EXPECT_EQ(consumed, additions);
+}
+
+TEST(NotificationCounter, WaitUntilTarget)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	NotificationCounter counter;
+
+	EXPECT_TRUE(counter.wait_until(0, 0ms));
+	EXPECT_FALSE(counter.wait_until(1, 10ms));
+
+	std::thread producer([&] {
+		for (int i = 0; i < 3; ++i) {
+			std::this_thread::sleep_for(1ms);
+			counter.add(1);
+		}
+	});
+	EXPECT_TRUE(counter.wait_until(3, 1s));
+	producer.join();
+	// Waiting does not consume the count
+	EXPECT_EQ(counter.value(), 3);
+	EXPECT_TRUE(counter.wait_until(2, 0ms));
+}
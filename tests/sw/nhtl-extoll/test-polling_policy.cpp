@@ -0,0 +1,26 @@
+#include <chrono>
+#include <gtest/gtest.h>
+
+#include "nhtl-extoll/notification_poller.h"
+
+TEST(PollingPolicy, BlockingBacksOffAfterFailedWait)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+
+	auto policy = PollingPolicy::blocking();
+	policy.min_sleep = 100us;
+	policy.max_sleep = 400us;
+
+	auto period = policy.min_sleep;
+	auto const first = policy.idle(0, period);
+	EXPECT_GE(first.slept, 100us);
+	EXPECT_FALSE(first.max_backoff);
+	EXPECT_EQ(period, 200us);
+
+	policy.idle(1, period);
+	auto const last = policy.idle(2, period);
+	EXPECT_GE(last.slept, 400us);
+	EXPECT_TRUE(last.max_backoff);
+	EXPECT_EQ(period, 400us);
+}
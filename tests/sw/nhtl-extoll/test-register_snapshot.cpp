@@ -0,0 +1,46 @@
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "nhtl-extoll/register_snapshot.h"
+
+TEST(RegisterSnapshot, SparseValues)
+{
+	using namespace nhtl_extoll;
+	RegisterRange const range{0x5000, 0x5020};
+	EXPECT_EQ(range.size(), 5);
+	EXPECT_TRUE(range.contains(0x5018));
+	EXPECT_FALSE(range.contains(0x5004));
+	EXPECT_FALSE(range.contains(0x5028));
+
+	std::vector<uint64_t> const values{0, 7, 0, 0, 9};
+	RegisterSnapshot const snapshot(range, values);
+	ASSERT_EQ(snapshot.entries().size(), 2);
+	EXPECT_EQ(snapshot.entries()[0].address, 0x5008);
+	EXPECT_EQ(snapshot.entries()[1].address, 0x5020);
+	EXPECT_EQ(snapshot.value(0x5008), 7);
+	EXPECT_EQ(snapshot.value(0x5010), 0);
+	EXPECT_THROW(snapshot.value(0x5028), std::out_of_range);
+
+	EXPECT_THROW(RegisterSnapshot(range, std::vector<uint64_t>(4)), std::invalid_argument);
+}
+
+TEST(RegisterSnapshot, Diff)
+{
+	using namespace nhtl_extoll;
+	RegisterSnapshot const before({0x0, 0x20}, std::vector<uint64_t>{1, 2, 0, 4, 5});
+	RegisterSnapshot const after({0x8, 0x28}, std::vector<uint64_t>{2, 3, 0, 5, 6});
+
+	EXPECT_TRUE(before.diff(before).empty());
+
+	// Registers outside of either range are not compared
+	auto const differences = after.diff(before);
+	ASSERT_EQ(differences.size(), 2);
+	EXPECT_EQ(differences[0].address, 0x10);
+	EXPECT_EQ(differences[0].before, 0);
+	EXPECT_EQ(differences[0].after, 3);
+	EXPECT_EQ(differences[1].address, 0x18);
+	EXPECT_EQ(differences[1].before, 4);
+	EXPECT_EQ(differences[1].after, 0);
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "nhtl-extoll/response_slots.h"
+
+TEST(ResponseSlots, AcquireAndRelease)
+{
+	using namespace nhtl_extoll;
+	ResponseSlots slots;
+	EXPECT_EQ(slots.available(), ResponseSlots::size);
+
+	std::vector<size_t> acquired(ResponseSlots::size + 10);
+	EXPECT_EQ(slots.acquire(acquired), ResponseSlots::size);
+	acquired.resize(ResponseSlots::size);
+	EXPECT_EQ(slots.available(), 0);
+	EXPECT_FALSE(slots.try_acquire());
+
+	std::sort(acquired.begin(), acquired.end());
+	EXPECT_EQ(std::adjacent_find(acquired.begin(), acquired.end()), acquired.end());
+	EXPECT_EQ(std::count(acquired.begin(), acquired.end(), ResponseSlots::reserved_slot), 0);
+
+	slots.release(acquired[42]);
+	EXPECT_EQ(slots.try_acquire(), acquired[42]);
+	EXPECT_THROW(slots.release(ResponseSlots::reserved_slot), std::out_of_range);
+}
+
+TEST(ResponseSlots, ConcurrentOwnership)
+{
+	using namespace nhtl_extoll;
+	ResponseSlots slots;
+	std::array<std::atomic<int>, PhysicalBuffer::response_slots> owners{};
+	std::atomic<bool> shared{false};
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i) {
+		threads.emplace_back([&] {
+			std::array<size_t, 64> batch;
+			for (int round = 0; round < 10000; ++round) {
+				size_t const count = slots.acquire(std::span(batch).first(round % 64 + 1));
+				for (size_t j = 0; j < count; ++j) {
+					shared = shared || owners[batch[j]].fetch_add(1) != 0;
+				}
+				for (size_t j = 0; j < count; ++j) {
+					owners[batch[j]].fetch_sub(1);
+					slots.release(batch[j]);
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	EXPECT_FALSE(shared);
+	EXPECT_EQ(slots.available(), ResponseSlots::size);
+}
+
+TEST(ResponseSlots, DeferredRelease)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	NotificationCounter completions;
+	ResponseSlots slots(&completions);
+
+	std::vector<size_t> acquired(ResponseSlots::size);
+	ASSERT_EQ(slots.acquire(acquired), ResponseSlots::size);
+
+	// The slot of an overdue read stays out of the pool until its response arrived
+	slots.release_after(acquired[7], 2);
+	size_t slot;
+	auto const start = std::chrono::steady_clock::now();
+	EXPECT_EQ(slots.acquire({&slot, 1}, start + 10ms), 0);
+	EXPECT_GE(std::chrono::steady_clock::now() - start, 10ms);
+
+	completions.add(2);
+	EXPECT_EQ(slots.acquire({&slot, 1}, start), 0);
+	completions.add(1);
+	EXPECT_EQ(slots.acquire({&slot, 1}, start), 1);
+	EXPECT_EQ(slot, acquired[7]);
+
+	// Each deferred slot returns once, even to concurrent callers
+	size_t completing = 0;
+	for (size_t i = 0; i < ResponseSlots::size; ++i) {
+		if (acquired[i] != slot) {
+			slots.release_after(acquired[i], 3 + i % 2);
+			completing += i % 2 == 0;
+		}
+	}
+	completions.add(1);
+	std::vector<std::thread> threads;
+	std::array<std::vector<size_t>, 4> reclaimed;
+	for (auto& taken : reclaimed) {
+		threads.emplace_back([&] {
+			taken.resize(ResponseSlots::size);
+			taken.resize(slots.acquire(taken, start));
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	size_t total = 0;
+	for (auto const& taken : reclaimed) {
+		total += taken.size();
+	}
+	EXPECT_EQ(total + slots.available(), completing);
+	EXPECT_THROW(slots.release_after(ResponseSlots::reserved_slot, 0), std::out_of_range);
+}
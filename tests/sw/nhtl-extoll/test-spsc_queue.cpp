@@ -0,0 +1,55 @@
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "nhtl-extoll/spsc_queue.h"
+
+TEST(SpscQueue, FullAndEmpty)
+{
+	using namespace nhtl_extoll;
+	SpscQueue<std::vector<uint64_t>> queue(2);
+	std::vector<uint64_t> value{1, 2, 3};
+
+	EXPECT_FALSE(queue.try_pop(value));
+	EXPECT_EQ(value.size(), 3);
+
+	EXPECT_TRUE(queue.try_push(std::vector<uint64_t>{1}));
+	EXPECT_TRUE(queue.try_push(std::vector<uint64_t>{2}));
+	std::vector<uint64_t> rejected{3};
+	EXPECT_FALSE(queue.try_push(std::move(rejected)));
+	EXPECT_EQ(rejected.size(), 1);
+	EXPECT_EQ(queue.size(), queue.capacity());
+
+	EXPECT_TRUE(queue.try_pop(value));
+	EXPECT_EQ(value, std::vector<uint64_t>{1});
+	EXPECT_TRUE(queue.try_pop(value));
+	EXPECT_EQ(value, std::vector<uint64_t>{2});
+	EXPECT_FALSE(queue.try_pop(value));
+	EXPECT_EQ(queue.size(), 0);
+}
+
+TEST(SpscQueue, PreservesOrderAcrossThreads)
+{
+	using namespace nhtl_extoll;
+	constexpr uint64_t count = 1'000'000;
+	SpscQueue<uint64_t> queue(64);
+
+	std::thread producer([&queue] {
+		for (uint64_t i = 0; i < count; ++i) {
+			uint64_t value = i;
+			while (!queue.try_push(std::move(value))) {
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	uint64_t value;
+	for (uint64_t i = 0; i < count; ++i) {
+		while (!queue.try_pop(value)) {
+			std::this_thread::yield();
+		}
+		ASSERT_EQ(value, i);
+	}
+	producer.join();
+}
@@ -0,0 +1,137 @@
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <unistd.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "nhtl-extoll/trace_file.h"
+
+namespace {
+
+std::filesystem::path temporary_path(char const* name)
+{
+	return std::filesystem::temp_directory_path() /
+	       (std::string(name) + "." + std::to_string(getpid()));
+}
+
+} // namespace
+
+TEST(TraceFile, RoundTrip)
+{
+	using namespace nhtl_extoll;
+	using namespace std::literals::chrono_literals;
+	auto const path = temporary_path("nhtl-trace-roundtrip");
+	auto const start = std::chrono::system_clock::now();
+
+	std::vector<uint64_t> words(1000);
+	std::iota(words.begin(), words.end(), 0);
+	{
+		TraceFileWriter writer(path, 7, 42, false, 5);
+		writer.append({words.data(), 10}, start);
+		writer.append(words, start + 1s);
+		writer.append({}, start + 2s);
+		EXPECT_EQ(writer.next_sequence(), 8);
+	}
+
+	TraceFileReader reader(path);
+	EXPECT_FALSE(reader.recovered());
+	EXPECT_EQ(reader.header().node, 7);
+	EXPECT_EQ(reader.header().identifier, 42);
+	ASSERT_EQ(reader.size(), 3);
+	for (auto const& entry : reader.index()) {
+		EXPECT_EQ(entry.offset % TraceFileWriter::alignment_bt, 0);
+	}
+
+	auto const chunk = reader.chunk(1);
+	EXPECT_EQ(chunk.header.sequence, 6);
+	EXPECT_EQ(chunk.header.node, 7);
+	EXPECT_EQ(std::vector<uint64_t>(chunk.words.begin(), chunk.words.end()), words);
+	EXPECT_TRUE(reader.chunk(2).words.empty());
+	EXPECT_THROW(reader.chunk(3), std::out_of_range);
+
+	EXPECT_EQ(reader.find(start - 1s), 0);
+	EXPECT_EQ(reader.find(start + 500ms), 1);
+	EXPECT_EQ(reader.find(start + 1s), 1);
+	EXPECT_EQ(reader.find(start + 3s), 3);
+
+	std::filesystem::remove(path);
+}
+
+TEST(TraceFile, RecoversUnfinishedFile)
+{
+	using namespace nhtl_extoll;
+	auto const path = temporary_path("nhtl-trace-recover");
+
+	std::vector<uint64_t> words(600, 0xcafe);
+	size_t size_bt;
+	{
+		TraceFileWriter writer(path, 1, 2);
+		writer.append(words);
+		writer.append(words);
+		size_bt = writer.size_bt();
+	}
+	// Cut off index and footer as if the recording process had crashed
+	std::filesystem::resize_file(path, size_bt);
+
+	TraceFileReader reader(path);
+	EXPECT_TRUE(reader.recovered());
+	ASSERT_EQ(reader.size(), 2);
+	EXPECT_EQ(reader.chunk(1).header.sequence, 1);
+	EXPECT_EQ(reader.chunk(1).words.size(), words.size());
+	EXPECT_EQ(reader.chunk(1).words.back(), 0xcafe);
+
+	std::filesystem::remove(path);
+}
+
+TEST(TraceFile, RejectsIndexBeyondFile)
+{
+	using namespace nhtl_extoll;
+	auto const path = temporary_path("nhtl-trace-corrupt");
+
+	std::vector<uint64_t> words(600, 0xcafe);
+	size_t size_bt;
+	{
+		TraceFileWriter writer(path, 1, 2);
+		writer.append(words);
+		writer.append(words);
+		size_bt = writer.size_bt();
+	}
+	// Let the second index entry point behind the end of the file
+	{
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		TraceIndexEntry entry;
+		file.seekg(size_bt + sizeof(TraceIndexEntry));
+		file.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+		entry.offset = std::filesystem::file_size(path) + TraceFileWriter::alignment_bt;
+		file.seekp(size_bt + sizeof(TraceIndexEntry));
+		file.write(reinterpret_cast<char const*>(&entry), sizeof(entry));
+	}
+	{
+		TraceFileReader reader(path);
+		EXPECT_TRUE(reader.recovered());
+		ASSERT_EQ(reader.size(), 2);
+		EXPECT_EQ(reader.chunk(1).words.size(), words.size());
+	}
+
+	// A chunk header announcing more words than fit into the file ends the recovery
+	{
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		TraceChunkHeader header;
+		size_t const offset = TraceFileWriter::alignment_bt + TraceFileWriter::chunk_size_bt(600);
+		file.seekg(offset);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		header.words = uint64_t(1) << 60;
+		file.seekp(offset);
+		file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	}
+	{
+		TraceFileReader reader(path);
+		EXPECT_TRUE(reader.recovered());
+		EXPECT_EQ(reader.size(), 1);
+	}
+
+	std::filesystem::remove(path);
+}